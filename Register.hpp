@@ -1,7 +1,7 @@
 #pragma once
 
 
-enum Register {
+enum Register : unsigned char {
   zero,
   ra,
   sp,
@@ -38,4 +38,8 @@ enum Register {
   a5,
   a6,
   a7,
+
+  // past the architectural registers: ALU results with rd = zero are written here
+  // so their handlers need no branch, nothing reads it back
+  zero_sink,
 };
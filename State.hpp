@@ -1,32 +1,37 @@
 #pragma once
 
-#include <map>
-#include <string>
+#include <array>
+#include <cstddef>
 #include "Register.hpp"
 #include "consts.hpp"
-#include <vector>
+#include "memory/Memory.hpp"
+
+struct DecodedInstruction;
+
+// bytes of the program image from its first to its last instruction
+struct CodeRegion {
+  long start = 0;
+  unsigned long size = 0;
+
+  // one unsigned compare for any width: address + width - 1 - start lies in [0, size + width - 1)
+  bool overlaps(long address, unsigned long width) const {
+    return (unsigned long) (address + (long) width - 1 - start) < size + width - 1;
+  }
+};
 
 struct State {
-  std::vector<long> registers;
-  std::byte *memory;
-  std::map<std::string, int> labels;
+  // embedded and line aligned, the hot registers share a cache line with nothing else
+  alignas(64) std::array<long, REGISTER_FILE_SLOTS> registers{};
+  Memory memory;
 
-  State() {
-    registers = std::vector<long>(AMOUNT_REGISTERS);
-    memory = new std::byte[AMOUNT_STACK];
-    registers[zero] = 0;
-    registers[pc] = 0;
-  };
+  // decode cache of the program image, indexed by pc / INSTRUCTION_SIZE; a store into code
+  // marks the records it overwrites Opcode::Stale and sets code_written for good
+  DecodedInstruction* decoded = nullptr;
+  CodeRegion code;
+  bool code_written = false;
 
-  State(std::map<std::string, int> labels) {
-    registers = std::vector<long>(AMOUNT_REGISTERS);
-    memory = new std::byte[AMOUNT_STACK];
+  explicit State(unsigned long memory_size = DEFAULT_MEMORY_SIZE) : memory(memory_size) {
     registers[zero] = 0;
     registers[pc] = 0;
-    this->labels = labels;
-  }
-
-  ~State() {
-    delete[] memory;
-  }
+  };
 };
@@ -111,14 +111,9 @@ auto UI::render_registers(State* state) {
 
 auto UI::render_stack(State* state, int from, int to) {
     std::vector<std::vector<std::string>> vec = {{"  Number  ","Memory"}};
-    for (int i = from; i < to; i++) {
+    for (int i = from; i < to && state->memory.contains(i * 8, 8); i++) {
         std::string num  = std::to_string(i * 8);
-        long word = 0;
-        for (int j = 7; j > -1; j--) {
-            word = word << 8;
-            word += (int)state->memory[i * 8 + j];
-        }
-        std::string value = Interpreter::get_hex(word);
+        std::string value = Interpreter::get_hex(state->memory.load<long>(i * 8));
         vec.push_back({num, value});
     }
     auto table = Table(vec);
@@ -0,0 +1,111 @@
+#include "AotModule.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <fstream>
+#include <iostream>
+#include <spawn.h>
+#include <sstream>
+#include <sys/wait.h>
+
+#include "../content_hash.hpp"
+#include "../instructions/execute.hpp"
+#include "CppLowering.hpp"
+
+extern char** environ;
+
+static void aot_ecall(void* state) {
+    ecall(*static_cast<State*>(state));
+}
+
+// runs the compiler without a shell, so paths reach it as they are; $CXX may hold flags
+static bool compile(const std::string& source_path, const std::string& path) {
+    const char* compiler = std::getenv("CXX");
+    std::vector<std::string> arguments;
+    std::istringstream words(compiler != nullptr ? compiler : "");
+    for (std::string word; words >> word;) {
+        arguments.push_back(word);
+    }
+    if (arguments.empty()) {
+        arguments.push_back("c++");
+    }
+    for (const char* flag : {"-std=c++17", "-O2", "-fwrapv", "-shared", "-fPIC", "-o"}) {
+        arguments.push_back(flag);
+    }
+    arguments.push_back(path);
+    arguments.push_back(source_path);
+
+    std::vector<char*> argv;
+    for (std::string& argument : arguments) {
+        argv.push_back(argument.data());
+    }
+    argv.push_back(nullptr);
+    pid_t child;
+    if (posix_spawnp(&child, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+        return false;
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool AotModule::open(const std::string& path, unsigned long hash) {
+    // without a slash dlopen searches the library path instead of the current directory
+    std::string file = path.find('/') == std::string::npos ? "./" + path : path;
+    handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        return false;
+    }
+    auto* built_from = static_cast<const unsigned long*>(dlsym(handle, "aot_source_hash"));
+    run_function = reinterpret_cast<RunFunction>(dlsym(handle, "aot_run"));
+    if (built_from == nullptr || *built_from != hash || run_function == nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AotModule::close() {
+    if (handle != nullptr) {
+        dlclose(handle);
+    }
+    handle = nullptr;
+    run_function = nullptr;
+}
+
+bool AotModule::load(const std::string& path, const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels) {
+    std::string source = lower_to_cpp(program, labels);
+    const unsigned long hash = content_hash(source);
+    if (open(path, hash)) {
+        return true;
+    }
+
+    source += "\nextern \"C\" const unsigned long aot_source_hash = " + std::to_string(hash) + "UL;\n";
+    const std::string source_path = path + ".cpp";
+    {
+        std::ofstream out(source_path);
+        out << source;
+        if (!out) {
+            std::cerr << "Can not write " << source_path << std::endl;
+            return false;
+        }
+    }
+    const bool compiled = compile(source_path, path);
+    std::remove(source_path.c_str());
+    if (!compiled) {
+        std::cerr << "Can not compile " << path << std::endl;
+        return false;
+    }
+    rebuilt = true;
+    return open(path, hash);
+}
+
+bool AotModule::run(State& state, unsigned long& executed) {
+    return run_function(state.registers.data(), reinterpret_cast<unsigned char*>(state.memory.data()), &executed, aot_ecall, Memory::fault, &state) == 0;
+}
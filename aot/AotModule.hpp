@@ -0,0 +1,38 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../State.hpp"
+#include "../instructions/Instruction.hpp"
+
+/*  A program translated ahead of time by lower_to_cpp() and loaded with dlopen.
+    The shared object records a hash of its source, an existing file built from
+    the same program is loaded as it is, anything else is rebuilt with $CXX (c++
+    by default). */
+class AotModule {
+    using RunFunction = int (*)(long*, unsigned char*, unsigned long*, void (*)(void*), void (*)(long), void*);
+
+    void* handle = nullptr;
+    RunFunction run_function = nullptr;
+    bool rebuilt = false;
+
+    bool open(const std::string& path, unsigned long hash);
+    void close();
+
+   public:
+    AotModule() = default;
+    AotModule(const AotModule&) = delete;
+    AotModule& operator=(const AotModule&) = delete;
+
+    // false if the shared object could neither be loaded nor built
+    bool load(const std::string& path, const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels);
+
+    // runs from the pc of state, false if it stopped where the interpreter has to go on
+    bool run(State& state, unsigned long& executed);
+
+    bool was_rebuilt() const { return rebuilt; }
+
+    ~AotModule() { close(); }
+};
@@ -0,0 +1,278 @@
+#include "CppLowering.hpp"
+
+#include <sstream>
+
+#include "../State.hpp"
+#include "../consts.hpp"
+#include "../interpreter/BasicBlock.hpp"
+
+static const char* const OPCODE_NAMES[] = {
+#define OPCODE_NAME(name) #name,
+    OPCODE_LIST(OPCODE_NAME)
+#undef OPCODE_NAME
+};
+
+static const char* const PREAMBLE = R"(// generated by --aot, do not edit
+
+namespace {
+
+// an address with any of the upper 32 bits set does not come back from fault, as in the interpreter
+inline long offset(long address, void (*fault)(long)) {
+    if (__builtin_expect((unsigned long) address >> 32 != 0, 0)) {
+        fault(address);
+    }
+    return address;
+}
+
+// little-endian and zero-extending, as the interpreter, one host move on a little-endian host;
+// the empty asm keeps loads of unused values, below 4 GiB their guard page is the range check
+template <typename T>
+inline unsigned long load(const unsigned char* m, long address) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    T value;
+    __builtin_memcpy(&value, m + address, sizeof(T));
+    __asm__ volatile("" : "+r"(value));
+    return value;
+#else
+    unsigned long word = 0;
+    for (int i = (int) sizeof(T) - 1; i >= 0; i--) {
+        word = (word << 8) | m[address + i];
+    }
+    __asm__ volatile("" : "+r"(word));
+    return word;
+#endif
+}
+
+template <typename T>
+inline void store(unsigned char* m, long address, long value) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    T narrowed = (T) value;
+    __builtin_memcpy(m + address, &narrowed, sizeof(T));
+#else
+    for (int i = 0; i < (int) sizeof(T); i++) {
+        m[address + i] = (unsigned char) ((unsigned long) value >> (i * 8));
+    }
+#endif
+}
+
+}  // namespace
+
+)";
+
+// guest registers are locals of aot_run, so the compiler keeps them in host registers
+static std::string reg(Register r) {
+    return "x" + std::to_string(r);
+}
+
+static std::string address(long index) {
+    return std::to_string(index * INSTRUCTION_SIZE) + "UL";
+}
+
+static std::string constant(long value) {
+    return "(long) " + std::to_string((unsigned long) value) + "UL";
+}
+
+// Memory::offset() of the address of a load or store
+static std::string checked(const DecodedInstruction& in) {
+    return "offset(" + reg(in.rs1) + " + " + constant(in.immediate) + ", fault)";
+}
+
+// host type of the bytes a load or store moves
+static std::string access_type(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::Lw: case Opcode::Sw: return "unsigned long";
+        case Opcode::Lh: case Opcode::Sh: return "unsigned int";
+        default: return "unsigned char";
+    }
+}
+
+// writes the guest registers back to the state and reads them again around an ecall
+static std::string spill() {
+    std::string code;
+    for (int r = 0; r < AMOUNT_REGISTERS; r++) {
+        code += "registers[" + std::to_string(r) + "] = x" + std::to_string(r) + "; ";
+    }
+    return code;
+}
+
+static std::string reload() {
+    std::string code;
+    for (int r = 0; r < AMOUNT_REGISTERS; r++) {
+        code += "x" + std::to_string(r) + " = registers[" + std::to_string(r) + "]; ";
+    }
+    return code;
+}
+
+// memory faults are reported at the pc in the state, the local is only written back on exit;
+// the fence keeps the compiler from dropping or sinking the store past the access
+static std::string fault_pc(size_t index) {
+    return "registers[" + std::to_string(pc) + "] = " + std::to_string(index * INSTRUCTION_SIZE)
+        + "; __atomic_signal_fence(__ATOMIC_SEQ_CST); ";
+}
+
+// what a store into code does instead: leave before it, the interpreter runs it and marks its decode cache
+struct CodeStore {
+    CodeRegion code;
+    std::string leave;
+};
+
+static std::string store_into_code(const CodeStore& guard, const std::string& address, int size) {
+    return "if ((unsigned long) (" + address + " + " + std::to_string(size - 1 - guard.code.start) + "L) < "
+        + std::to_string(guard.code.size + size - 1) + "UL) { " + guard.leave + " } ";
+}
+
+// one statement for an instruction that is not a block exit
+static std::string lower_body(const DecodedInstruction& in, size_t index, const CodeStore& guard) {
+    // the sink is no local, nothing reads what is written to it
+    if (in.rd == zero_sink) {
+        return ";";
+    }
+    const std::string rd = reg(in.rd), rs1 = reg(in.rs1), rs2 = reg(in.rs2);
+    std::string statement;
+    switch (in.opcode) {
+        case Opcode::Add: statement = rd + " = " + rs1 + " + " + rs2 + ";"; break;
+        case Opcode::Sub: statement = rd + " = " + rs1 + " - " + rs2 + ";"; break;
+        case Opcode::And: statement = rd + " = " + rs1 + " & " + rs2 + ";"; break;
+        case Opcode::Or: statement = rd + " = " + rs1 + " | " + rs2 + ";"; break;
+        case Opcode::Xor: statement = rd + " = " + rs1 + " ^ " + rs2 + ";"; break;
+        // shift amounts are masked to 6 bits like the host shifts the interpreter runs on
+        case Opcode::SLL: statement = rd + " = (long) ((unsigned long) " + rs1 + " << (" + rs2 + " & 63));"; break;
+        case Opcode::SLLI: statement = rd + " = (long) ((unsigned long) " + rs1 + " << " + std::to_string(in.immediate & 63) + ");"; break;
+        case Opcode::SRL: statement = rd + " = " + rs1 + " >> (" + rs2 + " & 63);"; break;
+        case Opcode::SRLI: statement = rd + " = " + rs1 + " >> " + std::to_string(in.immediate & 63) + ";"; break;
+        case Opcode::Li: statement = rd + " = " + constant(in.immediate) + ";"; break;
+        case Opcode::Addi: statement = rd + " = " + rs1 + " + " + constant(in.immediate) + ";"; break;
+        case Opcode::Mv: statement = rd + " = " + rs1 + ";"; break;
+        case Opcode::La:
+            statement = rd + " = " + std::to_string(in.target * INSTRUCTION_SIZE) + ";";
+            break;
+        case Opcode::Lw: case Opcode::Lh: case Opcode::Lb: {
+            statement = fault_pc(index) + rd + " = (long) load<" + access_type(in.opcode) + ">(m, " + checked(in) + ");";
+            break;
+        }
+        case Opcode::Sw: case Opcode::Sh: case Opcode::Sb: {
+            const std::string address = checked(in);
+            const int size = in.opcode == Opcode::Sw ? 8 : in.opcode == Opcode::Sh ? 4 : 1;
+            statement = fault_pc(index) + store_into_code(guard, address, size)
+                + "store<" + access_type(in.opcode) + ">(m, " + address + ", " + rs2 + ");";
+            break;
+        }
+        case Opcode::Ecall:
+            // an exit ecall unwinds through aot_run, what ran so far is counted before
+            statement = spill() + " *executed += retired; retired = 0; ecall(state); " + reload();
+            break;
+        default:
+            // ebreak
+            statement = ";";
+            break;
+    }
+    return statement;
+}
+
+static std::string branch(const std::string& condition, const DecodedInstruction& in, size_t index) {
+    return "if (" + condition + ") { return " + address(in.target) + "; } return " + address(index + 1) + ";";
+}
+
+// the return statement ending a block at its exit
+static std::string lower_exit(const DecodedInstruction& in, size_t index, const CodeStore& guard) {
+    const std::string rs1 = reg(in.rs1), rs2 = reg(in.rs2);
+    switch (in.opcode) {
+        case Opcode::Jump:
+            return "return " + address(in.target) + ";";
+        case Opcode::Call:
+            return reg(ra) + " = " + std::to_string(index * INSTRUCTION_SIZE) + "; return " + address(in.target) + ";";
+        case Opcode::JumpAndLink:
+            return reg(in.rd) + " = " + std::to_string(index * INSTRUCTION_SIZE) + "; return " + address(in.target) + ";";
+        case Opcode::Return:
+            return "return " + reg(ra) + " + " + std::to_string(INSTRUCTION_SIZE) + ";";
+        case Opcode::BranchEqual: return branch(rs1 + " == " + rs2, in, index);
+        case Opcode::BranchEqualZero: return branch(rs1 + " == 0", in, index);
+        case Opcode::BranchNotEqual: return branch(rs1 + " != " + rs2, in, index);
+        case Opcode::BranchLessThen: return branch(rs1 + " < " + rs2, in, index);
+        case Opcode::BranchGreaterEqual: return branch(rs1 + " >= " + rs2, in, index);
+        case Opcode::BranchGreaterThen: return branch(rs1 + " > " + rs2, in, index);
+        default:
+            // ecall or an instruction using pc, which may have moved pc
+            return lower_body(in, index, guard) + " return " + reg(pc) + " + " + std::to_string(INSTRUCTION_SIZE) + ";";
+    }
+}
+
+std::string lower_to_cpp(const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels) {
+    const size_t size = program.size();
+    std::vector<bool> leaders = find_block_leaders(program, labels);
+    // data has no block, running into it hands over to the interpreter, which reports it
+    for (size_t i = 0; i < size; i++) {
+        if (program[i].opcode == Opcode::Data) {
+            leaders[i] = true;
+            leaders[i + 1] = true;
+        }
+    }
+
+    // the same region as the interpreter: first to last instruction
+    CodeStore guard;
+    for (size_t i = 0; i < size; i++) {
+        if (program[i].opcode != Opcode::Data) {
+            if (guard.code.size == 0) {
+                guard.code.start = i * INSTRUCTION_SIZE;
+            }
+            guard.code.size = (i + 1) * INSTRUCTION_SIZE - guard.code.start;
+        }
+    }
+
+    std::ostringstream out;
+    out << PREAMBLE;
+    out << "extern \"C\" int aot_run(long* registers, unsigned char* m, unsigned long* executed, void (*ecall)(void*), void (*fault)(long), void* state) {\n";
+    for (int r = 0; r < AMOUNT_REGISTERS; r++) {
+        out << "    long x" << r << " = registers[" << r << "];\n";
+    }
+    out << "    unsigned long retired = 0;\n";
+    out << "    bool running = true;\n\n";
+
+    std::vector<size_t> starts;
+    for (size_t start = 0; start < size; start++) {
+        if (!leaders[start] || program[start].opcode == Opcode::Data) {
+            continue;
+        }
+        size_t end = start + 1;
+        while (end < size && !leaders[end]) {
+            end++;
+        }
+        starts.push_back(start);
+
+        // always inlined: a lambda left as a call would take the address of the registers
+        out << "    auto block_" << start << " = [&]() __attribute__((always_inline)) -> unsigned long {\n";
+        out << "        retired += " << end - start << ";\n";
+        for (size_t i = start; i < end; i++) {
+            const DecodedInstruction& in = program[i];
+            bool exit = i + 1 == end && (is_control(in.opcode) || uses_pc(in) || in.opcode == Opcode::Ecall);
+            out << "        ";
+            if (uses_pc(in) || in.opcode == Opcode::Ecall) {
+                out << reg(pc) << " = " << i * INSTRUCTION_SIZE << "; ";
+            }
+            guard.leave = "running = false; retired -= " + std::to_string(end - i) + "; return " + address(i) + ";";
+            out << (exit ? lower_exit(in, i, guard) : lower_body(in, i, guard));
+            out << "  // " << OPCODE_NAMES[static_cast<int>(in.opcode)] << "\n";
+            if (i + 1 == end && !exit) {
+                out << "        return " << address(end) << ";\n";
+            }
+        }
+        out << "    };\n\n";
+    }
+
+    out << "    unsigned long address = " << reg(pc) << ";\n";
+    out << "    while (running) {\n";
+    // block ids are scaled to addresses, a misaligned pc matches no case
+    out << "        switch (address) {\n";
+    for (size_t start : starts) {
+        out << "            case " << address(start) << ": address = block_" << start << "(); break;\n";
+    }
+    out << "            default: running = false;\n";
+    out << "        }\n";
+    out << "    }\n";
+    out << "    " << reg(pc) << " = address;\n";
+    out << "    " << spill() << "\n";
+    out << "    *executed += retired;\n";
+    out << "    return address >= " << address(size) << " ? 0 : 1;\n";
+    out << "}\n";
+    return out.str();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../instructions/Instruction.hpp"
+
+/*  Lowers a parsed program to C++ source with one function (a lambda over the
+    guest registers, which are locals) per basic block and a switch on the block
+    id for jumps. The source exports
+
+        extern "C" int aot_run(long* registers, unsigned char* memory, unsigned long* executed,
+                               void (*ecall)(void*), void (*fault)(long), void* state);
+
+    which runs from registers[pc] and returns 0 once pc leaves the program, or
+    1 with registers[pc] at an instruction it can not run (data, a misaligned pc,
+    a jump into the middle of a block, a store into code), where the interpreter
+    takes over.
+    ecall is called with state after the registers and executed were written
+    back, it may throw. fault is Memory::fault() for an address that does not
+    fit into 32 bits. */
+std::string lower_to_cpp(const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels);
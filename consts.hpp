@@ -18,8 +18,16 @@
 
 #define INSTRUCTION_SIZE 8
 
+// block entries before promotion to the next tier, see Interpreter::set_engine
+#define JIT_THRESHOLD 50
+#define TIERED_BLOCK_THRESHOLD 8
+#define TIERED_JIT_THRESHOLD 1000
+
 #define BYTE_BITS 8
 
 
 #define AMOUNT_REGISTERS 33
-#define AMOUNT_STACK 10000
+// AMOUNT_REGISTERS and the zero sink, padded to whole cache lines
+#define REGISTER_FILE_SLOTS 40
+// guest address space in bytes unless --memory is given, pages are allocated on first write
+#define DEFAULT_MEMORY_SIZE (16UL << 20)
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+
+// FNV-1a, stable across runs and builds unlike std::hash; pass the last hash to continue it
+constexpr unsigned long content_hash(std::string_view bytes, unsigned long hash = 14695981039346656037UL) {
+    for (unsigned char c : bytes) {
+        hash = (hash ^ c) * 1099511628211UL;
+    }
+    return hash;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "EmulatorException.hpp"
+
+class EmitException: public EmulatorException {
+    public:
+        EmitException(const std::string& message): EmulatorException(message) {}
+};
@@ -0,0 +1,12 @@
+#pragma once
+#include "EmulatorException.hpp"
+
+// thrown by the exit ecalls, main catches it after the engines and returns code
+class ExitException: public EmulatorException {
+    public:
+        ExitException(int code): code(code) {}
+        int get_code() const {return code;};
+
+    private:
+        int code;
+};
@@ -0,0 +1,7 @@
+#pragma once
+#include "EmulatorException.hpp"
+
+class LoaderException: public EmulatorException {
+    public:
+        LoaderException(const std::string& message): EmulatorException(message) {}
+};
@@ -0,0 +1,262 @@
+#include "ElfLoader.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <iterator>
+
+#include "../consts.hpp"
+#include "../instructions/encoding.hpp"
+#include "../memory_access.hpp"
+
+// in the order of enum Register, a result for the sink was one for zero
+static const char* const REGISTER_NAMES[] = {
+    "zero", "ra", "sp", "gp", "tp", "pc",
+    "t0", "t1", "t2", "t3", "t4", "t5", "t6",
+    "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11",
+    "a0", "a1", "a2", "a3", "a4", "a5", "a6", "a7",
+    "zero",
+};
+
+static std::string hex(unsigned long value) {
+    char text[24];
+    std::snprintf(text, sizeof(text), "0x%lx", value);
+    return text;
+}
+
+// whole structures only, a truncated or lying header is an error rather than a read past the file
+template <typename T>
+static T read_at(const std::vector<unsigned char>& file, unsigned long offset) {
+    T value;
+    if (offset > file.size() || sizeof(T) > file.size() - offset) {
+        throw LoaderException("ELF file truncated at " + hex(offset));
+    }
+    std::memcpy(&value, file.data() + offset, sizeof(T));
+    return value;
+}
+
+// the line of the listing for instruction, targets by label where there is one
+static std::string disassemble(const DecodedInstruction& in, const std::vector<std::string>& label_at) {
+    const std::string rd = REGISTER_NAMES[in.rd], rs1 = REGISTER_NAMES[in.rs1], rs2 = REGISTER_NAMES[in.rs2];
+    const std::string imm = std::to_string(in.immediate);
+    const std::string target = (size_t) in.target < label_at.size() && !label_at[in.target].empty()
+        ? label_at[in.target] : hex(in.target * INSTRUCTION_SIZE);
+    switch (in.opcode) {
+        case Opcode::Add: return "add " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::Sub: return "sub " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::And: return "and " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::Or: return "or " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::Xor: return "xor " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::SLL: return "sll " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::SRL: return "srl " + rd + ", " + rs1 + ", " + rs2;
+        case Opcode::Addi: return "addi " + rd + ", " + rs1 + ", " + imm;
+        case Opcode::SLLI: return "slli " + rd + ", " + rs1 + ", " + imm;
+        case Opcode::SRLI: return "srli " + rd + ", " + rs1 + ", " + imm;
+        case Opcode::Li: return "li " + rd + ", " + imm;
+        case Opcode::Mv: return "mv " + rd + ", " + rs1;
+        case Opcode::La: return "la " + rd + ", " + target;
+        case Opcode::Lw: return "lw " + rd + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Lh: return "lh " + rd + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Lb: return "lb " + rd + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Sw: return "sw " + rs2 + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Sh: return "sh " + rs2 + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Sb: return "sb " + rs2 + ", " + imm + "(" + rs1 + ")";
+        case Opcode::Jump: return "j " + target;
+        case Opcode::Call: return "call " + target;
+        case Opcode::JumpAndLink: return "jal " + rd + ", " + target;
+        case Opcode::Return: return "ret";
+        case Opcode::BranchEqual: return "beq " + rs1 + ", " + rs2 + ", " + target;
+        case Opcode::BranchEqualZero: return "beqz " + rs1 + ", " + target;
+        case Opcode::BranchNotEqual: return "bne " + rs1 + ", " + rs2 + ", " + target;
+        case Opcode::BranchLessThen: return "blt " + rs1 + ", " + rs2 + ", " + target;
+        case Opcode::BranchGreaterEqual: return "bge " + rs1 + ", " + rs2 + ", " + target;
+        case Opcode::BranchGreaterThen: return "bgt " + rs1 + ", " + rs2 + ", " + target;
+        case Opcode::Ecall: return "ecall";
+        case Opcode::EBreak: return "ebreak";
+        default: return ".word " + imm;
+    }
+}
+
+bool is_elf_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[SELFMAG] = {};
+    in.read(magic, SELFMAG);
+    return in && std::memcmp(magic, ELFMAG, SELFMAG) == 0;
+}
+
+Program load_elf(const std::string& path, unsigned long memory_size, std::vector<std::string>& listing, long& entry) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw LoaderException("Can not open " + path);
+    }
+    const std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    const auto header = read_at<Elf64_Ehdr>(file, 0);
+    if (std::memcmp(header.e_ident, ELFMAG, SELFMAG) != 0 || header.e_ident[EI_CLASS] != ELFCLASS64
+            || header.e_ident[EI_DATA] != ELFDATA2LSB || header.e_machine != EM_RISCV) {
+        throw LoaderException(path + " is no little-endian RV64 ELF file");
+    }
+    if (header.e_type != ET_EXEC) {
+        throw LoaderException(path + " is no executable, only statically linked executables are loaded");
+    }
+
+    // the byte image from address 0 to the end of the last segment, executable slots and ranges marked
+    std::vector<std::byte> bytes;
+    std::vector<bool> executable;
+    std::vector<std::pair<unsigned long, unsigned long>> code;
+    for (unsigned i = 0; i < header.e_phnum; i++) {
+        const auto segment = read_at<Elf64_Phdr>(file, header.e_phoff + (unsigned long) i * header.e_phentsize);
+        if (segment.p_type != PT_LOAD || segment.p_memsz == 0) {
+            continue;
+        }
+        if (segment.p_filesz > segment.p_memsz || segment.p_offset > file.size() || segment.p_filesz > file.size() - segment.p_offset) {
+            throw LoaderException("Segment at " + hex(segment.p_vaddr) + " lies outside of " + path);
+        }
+        if (segment.p_vaddr > memory_size || segment.p_memsz > memory_size - segment.p_vaddr) {
+            throw LoaderException("Segment at " + hex(segment.p_vaddr) + " does not fit into " + std::to_string(memory_size) + " bytes of memory");
+        }
+        const unsigned long end = (segment.p_vaddr + segment.p_memsz + INSTRUCTION_SIZE - 1) / INSTRUCTION_SIZE * INSTRUCTION_SIZE;
+        if (end > bytes.size()) {
+            bytes.resize(end);
+            executable.resize(end / INSTRUCTION_SIZE);
+        }
+        std::memcpy(bytes.data() + segment.p_vaddr, file.data() + segment.p_offset, segment.p_filesz);
+        if (segment.p_flags & PF_X) {
+            for (unsigned long slot = segment.p_vaddr / INSTRUCTION_SIZE; slot * INSTRUCTION_SIZE < segment.p_vaddr + segment.p_memsz; slot++) {
+                executable[slot] = true;
+            }
+            code.emplace_back(segment.p_vaddr, segment.p_vaddr + segment.p_filesz);
+        }
+    }
+
+    Program program;
+    const size_t slots = executable.size();
+    size_t decoded = 0, undecoded = 0;
+    for (size_t i = 0; i < slots; i++) {
+        const uint64_t slot = load<uint64_t>(bytes.data(), i * INSTRUCTION_SIZE);
+        program.image.push_back(slot);
+        program.instructions.push_back(executable[i] ? decode_slot(slot, i) : DecodedInstruction{Opcode::Data, zero, zero, zero, (long) slot});
+        // li of a 64-bit constant loads it from the pool write_elf() puts after the program
+        Register rd;
+        size_t pool_index;
+        if (executable[i] && program.instructions.back().opcode == Opcode::Data
+                && decode_constant_load(slot, i, rd, pool_index) && pool_index < slots) {
+            program.instructions.back() = DecodedInstruction{Opcode::Li, rd, zero, zero, (long) load<uint64_t>(bytes.data(), pool_index * INSTRUCTION_SIZE)};
+        }
+        if (executable[i]) {
+            (program.instructions.back().opcode == Opcode::Data ? undecoded : decoded)++;
+        }
+    }
+
+    /*  Two words of a 4-byte stream seldom read as a slot, so code in which
+        most slots do not decode is such a stream. Its instructions are
+        decoded again one by one into slots after the image, the original
+        bytes stay where they are as data for loads. word_slot maps the
+        address / STREAM_STRIDE of an instruction to its slot. */
+    const bool stream = undecoded > decoded;
+    for (size_t i = 0; i < slots && !stream; i++) {
+        if (executable[i] && program.instructions[i].opcode == Opcode::Data) {
+            throw LoaderException("Unsupported instruction " + hex(program.image[i]) + " at " + hex(i * INSTRUCTION_SIZE) + " of " + path);
+        }
+    }
+    std::vector<long> word_slot;
+    if (stream) {
+        word_slot.assign(bytes.size() / STREAM_STRIDE, -1);
+        for (size_t i = 0; i < slots; i++) {
+            if (executable[i]) {
+                program.instructions[i] = DecodedInstruction{Opcode::Data, zero, zero, zero, (long) program.image[i]};
+            }
+        }
+        for (const auto& [begin, end] : code) {
+            for (unsigned long address = (begin + STREAM_STRIDE - 1) / STREAM_STRIDE * STREAM_STRIDE; address + STREAM_STRIDE <= end; ) {
+                const uint32_t first = load<uint32_t>(bytes.data(), address);
+                const uint32_t second = address + 2 * STREAM_STRIDE <= end ? load<uint32_t>(bytes.data(), address + STREAM_STRIDE) : 0;
+                bool pair;
+                word_slot[address / STREAM_STRIDE] = program.instructions.size();
+                program.instructions.push_back(decode_stream(first, second, address, pair));
+                if (program.instructions.back().opcode == Opcode::Data) {
+                    throw LoaderException("Unsupported instruction " + hex(first) + " at " + hex(address) + " of " + path);
+                }
+                address += pair ? 2 * STREAM_STRIDE : STREAM_STRIDE;
+            }
+        }
+        // targets by word become targets by slot, la of anything but code keeps the address as a constant
+        for (size_t i = slots; i < program.instructions.size(); i++) {
+            DecodedInstruction& in = program.instructions[i];
+            const bool to_code = (size_t) in.target < word_slot.size() && word_slot[in.target] >= 0;
+            if (in.opcode == Opcode::La && !to_code) {
+                in = DecodedInstruction{Opcode::Li, sink_zero(in.rd), zero, zero, in.target * STREAM_STRIDE};
+            } else if (in.opcode == Opcode::La || (is_control(in.opcode) && in.opcode != Opcode::Return)) {
+                if (!to_code) {
+                    throw LoaderException("Jump to " + hex(in.target * STREAM_STRIDE) + " which is no instruction of " + path);
+                }
+                in.target = word_slot[in.target];
+            }
+        }
+        for (size_t i = slots; i < program.instructions.size(); i++) {
+            program.image.push_back(encode_slot(program.instructions[i], i));
+        }
+        if (program.image.size() * INSTRUCTION_SIZE > memory_size) {
+            throw LoaderException("Code of " + path + " does not fit into " + std::to_string(memory_size) + " bytes of memory");
+        }
+    }
+
+    // the slot of an address in the loaded program, -1 for none
+    const auto slot_at = [&](unsigned long address) -> long {
+        if (stream && address / STREAM_STRIDE < word_slot.size() && address % STREAM_STRIDE == 0 && word_slot[address / STREAM_STRIDE] >= 0) {
+            return word_slot[address / STREAM_STRIDE];
+        }
+        return address % INSTRUCTION_SIZE == 0 && address / INSTRUCTION_SIZE < slots ? (long) (address / INSTRUCTION_SIZE) : -1;
+    };
+
+    const long entry_slot = slot_at(header.e_entry);
+    if (entry_slot < 0 || (!stream && !executable[entry_slot]) || program.instructions[entry_slot].opcode == Opcode::Data) {
+        throw LoaderException("Entry point " + hex(header.e_entry) + " is no instruction");
+    }
+    entry = entry_slot * INSTRUCTION_SIZE;
+
+    // symbols at a slot, the first of several names at one address names its targets in the listing
+    const size_t all_slots = program.instructions.size();
+    std::vector<std::vector<std::string>> names_at(all_slots);
+    for (unsigned i = 0; i < header.e_shnum; i++) {
+        const auto section = read_at<Elf64_Shdr>(file, header.e_shoff + (unsigned long) i * header.e_shentsize);
+        if (section.sh_type != SHT_SYMTAB || section.sh_entsize != sizeof(Elf64_Sym)) {
+            continue;
+        }
+        const auto strings = read_at<Elf64_Shdr>(file, header.e_shoff + (unsigned long) section.sh_link * header.e_shentsize);
+        for (unsigned long offset = sizeof(Elf64_Sym); offset + sizeof(Elf64_Sym) <= section.sh_size; offset += sizeof(Elf64_Sym)) {
+            const auto symbol = read_at<Elf64_Sym>(file, section.sh_offset + offset);
+            const int type = ELF64_ST_TYPE(symbol.st_info);
+            if ((type != STT_NOTYPE && type != STT_FUNC && type != STT_OBJECT) || symbol.st_shndx == SHN_UNDEF
+                    || slot_at(symbol.st_value) < 0 || symbol.st_name >= strings.sh_size || strings.sh_offset + symbol.st_name >= file.size()) {
+                continue;
+            }
+            const char* name = reinterpret_cast<const char*>(file.data() + strings.sh_offset + symbol.st_name);
+            const std::string label(name, strnlen(name, file.size() - strings.sh_offset - symbol.st_name));
+            // .L names are local to the assembler, like the pcrel_hi labels of la
+            if (!label.empty() && label.rfind(".L", 0) != 0 && program.labels.emplace(label, slot_at(symbol.st_value)).second) {
+                names_at[slot_at(symbol.st_value)].push_back(label);
+            }
+        }
+    }
+
+    std::vector<std::string> label_at(all_slots);
+    for (size_t i = 0; i < all_slots; i++) {
+        if (!names_at[i].empty()) {
+            label_at[i] = names_at[i].front();
+        }
+    }
+    // label lines map to -3 like the preprocessor maps them
+    listing.clear();
+    for (size_t i = 0; i < all_slots; i++) {
+        for (const std::string& name : names_at[i]) {
+            program.from_in_to_inparse.push_back(-3);
+            listing.push_back(name + ":");
+        }
+        program.from_in_to_inparse.push_back(i);
+        program.from_inparse_to_in.push_back(listing.size());
+        listing.push_back("  " + disassemble(program.instructions[i], label_at));
+    }
+    return program;
+}
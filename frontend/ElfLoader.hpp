@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../exceptions/LoaderException.hpp"
+#include "Program.hpp"
+
+/*  Loads a statically linked RV64 ELF executable in place of assembler text.
+    The PT_LOAD segments are copied into the program image at their addresses.
+    Code laid out the way this emulator runs it, one instruction or pair per
+    INSTRUCTION_SIZE bytes as write_elf() writes it for --emit, is decoded in
+    place with decode_slot(). A plain 4-byte instruction stream is decoded with
+    decode_stream() into slots after the image, and its addresses of code map
+    to those slots for the entry point, jumps, la and symbols; its bytes stay
+    in place for loads, so stores into them do not change the code.
+    Code is not run on a best effort: an instruction of an executable segment
+    outside the subset of encoding.hpp is an error naming its address.
+    Defined symbols of .symtab at a slot become labels, and a listing of the
+    decoded program stands in for the source lines of the debugger. */
+
+// true if path starts with the ELF magic
+bool is_elf_file(const std::string& path);
+
+// throws LoaderException for anything that is not such an executable fitting memory_size bytes
+Program load_elf(const std::string& path, unsigned long memory_size, std::vector<std::string>& listing, long& entry);
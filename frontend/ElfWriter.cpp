@@ -0,0 +1,208 @@
+#include "ElfWriter.hpp"
+
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <vector>
+
+#include "../consts.hpp"
+#include "../instructions/encoding.hpp"
+#include "../memory_access.hpp"
+
+// the slots of the image and its constant pool, every instruction has to have an encoding to be shipped
+static std::vector<uint64_t> encoded_image(const Program& program) {
+    std::vector<uint64_t> image = program.image;
+    const size_t slots = program.instructions.size();
+    if (image.size() != slots) {
+        image.clear();
+        for (size_t i = 0; i < slots; i++) {
+            image.push_back(encode_slot(program.instructions[i], i));
+        }
+    }
+    std::vector<uint64_t> pool;
+    for (size_t i = 0; i < slots; i++) {
+        const DecodedInstruction& instruction = program.instructions[i];
+        if (image[i] == NO_ENCODING && instruction.opcode == Opcode::Li) {
+            image[i] = encode_constant_load(instruction.rd, i, slots + pool.size());
+            pool.push_back((uint64_t) instruction.immediate);
+        }
+        if (image[i] == NO_ENCODING && instruction.opcode != Opcode::Data) {
+            std::string line = i < program.from_inparse_to_in.size() ? std::to_string(program.from_inparse_to_in[i] + 1) : "?";
+            throw EmitException("In line " + line + " instruction has no RV64 encoding (an operand of pc or an immediate out of range)");
+        }
+    }
+    image.insert(image.end(), pool.begin(), pool.end());
+    return image;
+}
+
+static std::vector<std::byte> image_bytes(const std::vector<uint64_t>& image) {
+    std::vector<std::byte> bytes(image.size() * INSTRUCTION_SIZE);
+    for (size_t i = 0; i < image.size(); i++) {
+        store<uint64_t>(bytes.data(), i * INSTRUCTION_SIZE, image[i]);
+    }
+    return bytes;
+}
+
+static void write_file(const std::string& path, const std::string& contents) {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    if (!out) {
+        throw EmitException("Can not write " + path);
+    }
+}
+
+template <typename T>
+static void append(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// a string table, offset 0 is the empty name
+static unsigned add_name(std::string& table, const std::string& name) {
+    if (table.empty()) {
+        table.push_back('\0');
+    }
+    const unsigned offset = table.size();
+    table += name;
+    table.push_back('\0');
+    return offset;
+}
+
+void write_flat_binary(const std::string& path, const Program& program) {
+    const std::vector<std::byte> bytes = image_bytes(encoded_image(program));
+    write_file(path, std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+void write_elf(const std::string& path, const Program& program) {
+    const std::vector<uint64_t> image = encoded_image(program);
+    const std::vector<std::byte> bytes = image_bytes(image);
+    const size_t slots = program.instructions.size();
+
+    // maximal runs of instructions or data, a segment and a section each, the constant pool is data
+    struct Run {
+        size_t start, end;
+        bool code;
+    };
+    std::vector<Run> runs;
+    for (size_t i = 0; i < image.size(); i++) {
+        const bool code = i < slots && program.instructions[i].opcode != Opcode::Data;
+        if (runs.empty() || runs.back().code != code) {
+            runs.push_back({i, i, code});
+        }
+        runs.back().end = i + 1;
+    }
+    long entry = 0;
+    for (const Run& run : runs) {
+        if (run.code) {
+            entry = run.start * INSTRUCTION_SIZE;
+            break;
+        }
+    }
+
+    // the section of every slot for the symbols, labels past the end are absolute
+    std::vector<unsigned> section_of(image.size() + 1, SHN_ABS);
+    for (size_t r = 0; r < runs.size(); r++) {
+        for (size_t i = runs[r].start; i < runs[r].end; i++) {
+            section_of[i] = r + 1;
+        }
+    }
+    std::string strtab;
+    std::string symtab;
+    append(symtab, Elf64_Sym{});
+    for (const auto& [name, index] : program.labels) {
+        Elf64_Sym symbol = {};
+        symbol.st_name = add_name(strtab, name);
+        const bool code = (size_t) index < slots && program.instructions[index].opcode != Opcode::Data;
+        symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, code ? STT_FUNC : STT_OBJECT);
+        symbol.st_shndx = (size_t) index <= slots ? section_of[index] : SHN_ABS;
+        symbol.st_value = (unsigned long) index * INSTRUCTION_SIZE;
+        append(symtab, symbol);
+    }
+    if (strtab.empty()) {
+        add_name(strtab, "");
+    }
+
+    // layout: header, program headers, image, symbols, strings, section headers
+    const unsigned long image_offset = (sizeof(Elf64_Ehdr) + runs.size() * sizeof(Elf64_Phdr) + INSTRUCTION_SIZE - 1) / INSTRUCTION_SIZE * INSTRUCTION_SIZE;
+    const unsigned long symtab_offset = image_offset + bytes.size();
+    const unsigned long strtab_offset = symtab_offset + symtab.size();
+    std::string shstrtab;
+    std::vector<Elf64_Shdr> sections(1);
+    for (const Run& run : runs) {
+        Elf64_Shdr section = {};
+        section.sh_name = add_name(shstrtab, run.code ? ".text" : ".data");
+        section.sh_type = SHT_PROGBITS;
+        section.sh_flags = SHF_ALLOC | (run.code ? SHF_EXECINSTR : SHF_WRITE);
+        section.sh_addr = run.start * INSTRUCTION_SIZE;
+        section.sh_offset = image_offset + run.start * INSTRUCTION_SIZE;
+        section.sh_size = (run.end - run.start) * INSTRUCTION_SIZE;
+        section.sh_addralign = INSTRUCTION_SIZE;
+        sections.push_back(section);
+    }
+    Elf64_Shdr symbols = {};
+    symbols.sh_name = add_name(shstrtab, ".symtab");
+    symbols.sh_type = SHT_SYMTAB;
+    symbols.sh_offset = symtab_offset;
+    symbols.sh_size = symtab.size();
+    symbols.sh_link = sections.size() + 1;
+    symbols.sh_info = 1;
+    symbols.sh_addralign = 8;
+    symbols.sh_entsize = sizeof(Elf64_Sym);
+    sections.push_back(symbols);
+    Elf64_Shdr strings = {};
+    strings.sh_name = add_name(shstrtab, ".strtab");
+    strings.sh_type = SHT_STRTAB;
+    strings.sh_offset = strtab_offset;
+    strings.sh_size = strtab.size();
+    strings.sh_addralign = 1;
+    sections.push_back(strings);
+    Elf64_Shdr names = {};
+    names.sh_name = add_name(shstrtab, ".shstrtab");
+    names.sh_type = SHT_STRTAB;
+    names.sh_offset = strtab_offset + strtab.size();
+    names.sh_size = shstrtab.size();
+    names.sh_addralign = 1;
+    sections.push_back(names);
+    const unsigned long section_offset = (names.sh_offset + names.sh_size + 7) / 8 * 8;
+
+    Elf64_Ehdr header = {};
+    std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS64;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_EXEC;
+    header.e_machine = EM_RISCV;
+    header.e_version = EV_CURRENT;
+    header.e_entry = entry;
+    header.e_phoff = runs.empty() ? 0 : sizeof(Elf64_Ehdr);
+    header.e_shoff = section_offset;
+    header.e_ehsize = sizeof(Elf64_Ehdr);
+    header.e_phentsize = sizeof(Elf64_Phdr);
+    header.e_phnum = runs.size();
+    header.e_shentsize = sizeof(Elf64_Shdr);
+    header.e_shnum = sections.size();
+    header.e_shstrndx = sections.size() - 1;
+
+    std::string out;
+    append(out, header);
+    for (const Run& run : runs) {
+        Elf64_Phdr segment = {};
+        segment.p_type = PT_LOAD;
+        segment.p_flags = PF_R | (run.code ? PF_X : PF_W);
+        segment.p_offset = image_offset + run.start * INSTRUCTION_SIZE;
+        segment.p_vaddr = segment.p_paddr = run.start * INSTRUCTION_SIZE;
+        segment.p_filesz = segment.p_memsz = (run.end - run.start) * INSTRUCTION_SIZE;
+        segment.p_align = INSTRUCTION_SIZE;
+        append(out, segment);
+    }
+    out.resize(image_offset);
+    out.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    out += symtab;
+    out += strtab;
+    out += shstrtab;
+    out.resize(section_offset);
+    for (const Elf64_Shdr& section : sections) {
+        append(out, section);
+    }
+    write_file(path, out);
+}
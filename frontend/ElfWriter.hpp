@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "../exceptions/EmitException.hpp"
+#include "Program.hpp"
+
+/*  Writes the program image as the assembler output of a program, encoded by
+    encode_slot() in the INSTRUCTION_SIZE-byte slots the interpreter runs and
+    load_elf() reads back. Runs of instructions become .text sections in
+    read-only executable segments, runs of data .data sections in writable
+    ones, and every label a symbol. li of a constant beyond 32 bits loads it
+    from a pool of data slots after the program. The flat binary is the bare
+    image from address 0. Both throw EmitException for an instruction without
+    an encoding or a file that can not be written. */
+
+void write_elf(const std::string& path, const Program& program);
+
+void write_flat_binary(const std::string& path, const Program& program);
@@ -1,37 +1,38 @@
 #include "Lexer.hpp"
+#include <algorithm>
 
 
 
-std::string Lexer::get_next_token() {
+std::string_view Lexer::get_next_token() {
     if (eof_flag) { return "eof"; }
-    std::string token = "";
-    char ch;
-    while (inparse) {
-        if (str_buffer != "") {
-            std::string ret = str_buffer;
-            str_buffer = "";
-            return ret;
-        }
-        ch = inparse.get();
-        if (inparse.eof()) { 
-            eof_flag = true;
-            if (token != "") { return token; }  
-            return "eof";
-        }
+    if (!separator.empty()) {
+        std::string_view ret = separator;
+        separator = {};
+        return ret;
+    }
+    size_t start = position;
+    while (position < inparse.size()) {
+        char ch = inparse[position];
         if (ch == ',' || ch == '\n' || ch == ' ' || ch == '\t') {
-            if (ch != ' ' && ch != '\t') { str_buffer += ch; }   // need to return , or \n token to check syntax or stop
-            if (token != "") { return token; }
+            std::string_view token = inparse.substr(start, position - start);
+            if (ch != ' ' && ch != '\t') { separator = inparse.substr(position, 1); }   // need to return , or \n token to check syntax or stop
+            position++;
+            if (!token.empty()) { return token; }
+            if (!separator.empty()) { return get_next_token(); }
+            start = position;
             continue;
         }
-        token += ch;
+        position++;
     }
-    return token; 
+    eof_flag = true;
+    if (start != position) { return inparse.substr(start, position - start); }  
+    return "eof";
 }
 
 
-std::vector<std::string> Lexer::get_tokens_until_end_line() {
-    std::vector<std::string> line;
-    std::string token = get_next_token();
+std::vector<std::string_view> Lexer::get_tokens_until_end_line() {
+    std::vector<std::string_view> line;
+    std::string_view token = get_next_token();
     while (token != "\n" && token != "eof") {
         line.push_back(token);
         token = get_next_token();
@@ -40,4 +41,20 @@ std::vector<std::string> Lexer::get_tokens_until_end_line() {
 }
 
 
-
+std::vector<std::pair<Lexer, int>> Lexer::split(size_t parts) const {
+    std::vector<std::pair<Lexer, int>> lexers;
+    size_t start = position;
+    int lines = 0;
+    for (size_t part = parts; part > 0 && start < inparse.size(); part--) {
+        size_t end = inparse.size();
+        if (part > 1) {
+            end = inparse.find('\n', start + (inparse.size() - start) / part);
+            end = end == std::string_view::npos ? inparse.size() : end + 1;
+        }
+        std::string_view chunk = inparse.substr(start, end - start);
+        lexers.emplace_back(Lexer(chunk), lines);
+        lines += std::count(chunk.begin(), chunk.end(), '\n');
+        start = end;
+    }
+    return lexers;
+}
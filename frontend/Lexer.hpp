@@ -1,19 +1,26 @@
 #pragma once
 #include <string>
-#include <iostream>
-#include <sstream>
+#include <string_view>
+#include <utility>
 #include <vector>
 #include "../exceptions/ParserException.hpp"
 
+// tokens are views into the preprocessed program, which has to outlive them
 class Lexer {
-    std::stringstream& inparse; 
-    std::string str_buffer;
-    bool eof_flag;
+    std::string_view inparse; 
+    size_t position = 0;
+    std::string_view separator;    // a , or \n right after the last token
+    bool eof_flag = false;
 
   public:
-    Lexer(std::stringstream& inparse_): inparse(inparse_) {}
+    Lexer(std::string_view inparse_): inparse(inparse_) {}
 
-    std::string get_next_token();
-    std::vector<std::string> get_tokens_until_end_line();
+    std::string_view get_next_token();
+    std::vector<std::string_view> get_tokens_until_end_line();
+    // the rest of the input, from the start of a line, cut at line ends into at most parts lexers
+    // of about the same size, each with the number of lines before it
+    std::vector<std::pair<Lexer, int>> split(size_t parts) const;
+    size_t remaining() const { return inparse.size() - position; }
+    std::string_view text() const { return inparse; }
 
-};
\ No newline at end of file
+};
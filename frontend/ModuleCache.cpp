@@ -0,0 +1,260 @@
+#include "ModuleCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <type_traits>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "../content_hash.hpp"
+
+// bumped whenever the layout below changes
+static constexpr unsigned long FORMAT_VERSION = 1;
+static constexpr unsigned long MAGIC = 0x31304f4d56565221UL;  // "!RVVMO01"
+
+/*  A module file is the magic, the format version and the path, then the
+    fields of the module in order. Numbers are 8 bytes in host byte order,
+    strings their length followed by their bytes, lists their length followed
+    by their elements. */
+
+static std::unordered_map<std::string, Preprocessor::Module> modules;
+
+static long modification_time(const struct stat& status) {
+    return status.st_mtim.tv_sec * 1000000000L + status.st_mtim.tv_nsec;
+}
+
+static bool read_file(const std::string& path, std::string& content) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return !in.bad();
+}
+
+bool stamp_file(const std::string& path, IncludedFile& file) {
+    struct stat status;
+    std::string content;
+    if (stat(path.c_str(), &status) != 0 || !read_file(path, content)) {
+        return false;
+    }
+    file = {path, modification_time(status), content_hash(content)};
+    return true;
+}
+
+bool unchanged(const IncludedFile& file) {
+    struct stat status;
+    if (stat(file.path.c_str(), &status) != 0) {
+        return false;
+    }
+    if (modification_time(status) == file.modified) {
+        return true;
+    }
+    std::string content;
+    return read_file(file.path, content) && content_hash(content) == file.hash;
+}
+
+static bool valid(const Preprocessor::Module& module) {
+    for (const IncludedFile& file : module.files) {
+        if (!unchanged(file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string cache_path(const std::string& dir, const std::string& path) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016lx.rvm", content_hash(path));
+    return dir + "/" + name;
+}
+
+class ModuleWriter {
+    std::string out;
+
+  public:
+    void put(unsigned long value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void put(const std::string& text) {
+        put(text.size());
+        out += text;
+    }
+    template <typename T, typename F>
+    void put(const std::vector<T>& list, F put_element) {
+        put(list.size());
+        for (const T& element : list) {
+            put_element(element);
+        }
+    }
+    const std::string& bytes() const { return out; }
+};
+
+// every read is false once one runs past the end
+class ModuleReader {
+    const std::string& in;
+    size_t offset = 0;
+
+  public:
+    explicit ModuleReader(const std::string& in_) : in(in_) {}
+
+    template <typename T> requires std::is_integral_v<T>
+    bool get(T& value) {
+        unsigned long raw;
+        if (in.size() - offset < sizeof(raw)) {
+            return false;
+        }
+        std::memcpy(&raw, in.data() + offset, sizeof(raw));
+        offset += sizeof(raw);
+        value = (T) raw;
+        return true;
+    }
+    bool get(std::string& text) {
+        unsigned long size;
+        if (!get(size) || size > in.size() - offset) {
+            return false;
+        }
+        text.assign(in, offset, size);
+        offset += size;
+        return true;
+    }
+    template <typename T, typename F>
+    bool get(std::vector<T>& list, F get_element) {
+        unsigned long size;
+        if (!get(size) || size > in.size() - offset) {
+            return false;
+        }
+        list.resize(size);
+        for (T& element : list) {
+            if (!get_element(element)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool at_end() const { return offset == in.size(); }
+};
+
+static std::string serialize(const std::string& path, const Preprocessor::Module& module) {
+    ModuleWriter out;
+    out.put(MAGIC);
+    out.put(FORMAT_VERSION);
+    out.put(path);
+    out.put(module.files, [&](const IncludedFile& file) {
+        out.put(file.path);
+        out.put((unsigned long) file.modified);
+        out.put(file.hash);
+    });
+    out.put(module.inparse);
+    out.put((unsigned long) module.lines);
+    out.put(module.labels, [&](const auto& label) {
+        out.put(label.first);
+        out.put((unsigned long) label.second);
+    });
+    out.put(module.eqv, [&](const auto& eqv) {
+        out.put(eqv.first);
+        out.put(eqv.second);
+    });
+    out.put(module.macros, [&](const auto& named) {
+        const Preprocessor::Macros& macro = named.second;
+        out.put(named.first);
+        out.put((unsigned long) macro.instances);
+        out.put(macro.params, [&](const std::string& param) { out.put(param); });
+        out.put(macro.labels, [&](const std::string& label) { out.put(label); });
+        out.put(macro.lines, [&](const Preprocessor::MacroLine& line) {
+            out.put((unsigned long) line.line);
+            out.put((unsigned long) line.defines_label);
+            out.put(line.pieces, [&](const Preprocessor::Piece& piece) {
+                out.put((unsigned long) piece.kind);
+                out.put(piece.text);
+                out.put((unsigned long) piece.index);
+            });
+        });
+    });
+    return out.bytes();
+}
+
+static bool deserialize(const std::string& bytes, const std::string& path, Preprocessor::Module& module) {
+    ModuleReader in(bytes);
+    unsigned long magic, version;
+    std::string stored_path;
+    if (!in.get(magic) || magic != MAGIC || !in.get(version) || version != FORMAT_VERSION
+            || !in.get(stored_path) || stored_path != path) {
+        return false;
+    }
+    return in.get(module.files, [&](IncludedFile& file) {
+            return in.get(file.path) && in.get(file.modified) && in.get(file.hash);
+        })
+        && in.get(module.inparse) && in.get(module.lines)
+        && in.get(module.labels, [&](auto& label) { return in.get(label.first) && in.get(label.second); })
+        && in.get(module.eqv, [&](auto& eqv) { return in.get(eqv.first) && in.get(eqv.second); })
+        && in.get(module.macros, [&](auto& named) {
+            Preprocessor::Macros& macro = named.second;
+            return in.get(named.first) && in.get(macro.instances)
+                && in.get(macro.params, [&](std::string& param) { return in.get(param); })
+                && in.get(macro.labels, [&](std::string& label) { return in.get(label); })
+                && in.get(macro.lines, [&](Preprocessor::MacroLine& line) {
+                    return in.get(line.line) && in.get(line.defines_label)
+                        && in.get(line.pieces, [&](Preprocessor::Piece& piece) {
+                            int kind;
+                            if (!in.get(kind) || !in.get(piece.text) || !in.get(piece.index)) {
+                                return false;
+                            }
+                            piece.kind = (Preprocessor::Piece::Kind) kind;
+                            // a damaged file must not index past the arguments or labels of the macro
+                            switch (piece.kind) {
+                                case Preprocessor::Piece::Text: case Preprocessor::Piece::Word: return true;
+                                case Preprocessor::Piece::Param: return piece.index >= 0 && piece.index < (int) macro.params.size();
+                                case Preprocessor::Piece::Label: return piece.index >= 0 && piece.index < (int) macro.labels.size();
+                            }
+                            return false;
+                        });
+                });
+        })
+        && in.at_end();
+}
+
+const Preprocessor::Module* find_module(const std::string& path, const std::string& dir) {
+    auto found = modules.find(path);
+    if (found != modules.end()) {
+        if (valid(found->second)) {
+            return &found->second;
+        }
+        modules.erase(found);
+    }
+    if (dir.empty()) {
+        return nullptr;
+    }
+    std::string bytes;
+    Preprocessor::Module module;
+    if (!read_file(cache_path(dir, path), bytes) || !deserialize(bytes, path, module) || !valid(module)) {
+        return nullptr;
+    }
+    return &(modules[path] = std::move(module));
+}
+
+const Preprocessor::Module& store_module(const std::string& path, Preprocessor::Module module, const std::string& dir) {
+    Preprocessor::Module& stored = modules[path] = std::move(module);
+    if (dir.empty()) {
+        return stored;
+    }
+    mkdir(dir.c_str(), 0777);
+    const std::string file = cache_path(dir, path);
+    const std::string temporary = file + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out << serialize(path, stored);
+        if (!out) {
+            std::cerr << "Can not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return stored;
+        }
+    }
+    if (std::rename(temporary.c_str(), file.c_str()) != 0) {
+        std::cerr << "Can not write " << file << std::endl;
+        std::remove(temporary.c_str());
+    }
+    return stored;
+}
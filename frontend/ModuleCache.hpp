@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include "Preprocessor.hpp"
+
+/*  Cache of the modules .include makes of files, keyed by their real path. A
+    module stays valid while every file it was made from keeps the modification
+    time it was read with or, failing that, its content hash. Modules are kept
+    in memory for the life of the process, so a file included again, by another
+    file or by a reload, is not read again. With a directory they are also kept
+    on disk, in files named after the hash of the path and replaced by rename
+    like the files of the program cache. */
+
+// path as it is now, false if it can not be read
+bool stamp_file(const std::string& path, IncludedFile& file);
+// true if file still has the content it was stamped with
+bool unchanged(const IncludedFile& file);
+
+// nullptr if neither memory nor dir holds a valid module of path
+const Preprocessor::Module* find_module(const std::string& path, const std::string& dir);
+// keeps module in memory and, if dir is not empty, writes it into dir
+const Preprocessor::Module& store_module(const std::string& path, Preprocessor::Module module, const std::string& dir);
@@ -1,6 +1,13 @@
 #include "Parser.hpp"
+#include "PerfectHash.hpp"
+#include "Preprocessor.hpp"
 
-std::map<std::string, Register> Parser::registers_names = {
+#include <algorithm>
+#include <climits>
+#include <exception>
+
+// the ABI names first, get_register_names() shows those
+static constexpr PerfectHash REGISTERS(std::to_array<std::pair<std::string_view, Register>>({
       {"zero", zero}, {"ra", ra}, {"sp", sp},
       {"gp", gp}, {"tp", tp}, {"pc", pc},
       {"t0", t0}, {"t1", t1}, {"t2", t2},
@@ -11,8 +18,66 @@ std::map<std::string, Register> Parser::registers_names = {
       {"s8", s8}, {"s9", s9}, {"s10", s10},
       {"s11", s11}, {"a0", a0}, {"a1", a1},
       {"a2", a2}, {"a3", a3}, {"a4", a4},
-      {"a5", a5}, {"a6", a6}, {"a7", a7} 
-};
+      {"a5", a5}, {"a6", a6}, {"a7", a7},
+      {"fp", s0},
+      {"x0", zero}, {"x1", ra}, {"x2", sp}, {"x3", gp},
+      {"x4", tp}, {"x5", t0}, {"x6", t1}, {"x7", t2},
+      {"x8", s0}, {"x9", s1}, {"x10", a0}, {"x11", a1},
+      {"x12", a2}, {"x13", a3}, {"x14", a4}, {"x15", a5},
+      {"x16", a6}, {"x17", a7}, {"x18", s2}, {"x19", s3},
+      {"x20", s4}, {"x21", s5}, {"x22", s6}, {"x23", s7},
+      {"x24", s8}, {"x25", s9}, {"x26", s10}, {"x27", s11},
+      {"x28", t3}, {"x29", t4}, {"x30", t5}, {"x31", t6}
+}));
+
+using InstructionFactory = Instruction* (*)(std::vector<std::string> args);
+
+template <typename T>
+static Instruction* make(std::vector<std::string> args) { return new T(args); }
+
+static constexpr PerfectHash MNEMONICS(std::to_array<std::pair<std::string_view, InstructionFactory>>({
+      {"add", make<Add>},
+      {"li", make<Li>},
+      {"addi", make<Addi>},
+      {"and", make<And>},
+      {"mv", make<Mv>},
+      {"or", make<Or>},
+      {"sll", make<SLL>},
+      {"srl", make<SRL>},
+      {"sub", make<Sub>},
+      {"xor", make<Xor>},
+      {"ecall", make<Ecall>},
+      {"call", make<Call>},
+      {"j", make<Jump>},
+      {"jal", make<JumpAndLink>},
+      {"beq", make<BranchEqual>},
+      {"bgt", make<BranchGreaterThen>},
+      {"bne", make<BranchNotEqual>},
+      {"blt", make<BranchLessThen>},
+      {"bge", make<BranchGreaterEqual>},
+      {"ret", make<Return>},
+      {"slli", make<SLLI>},
+      {"sb", make<Sb>},
+      {"sh", make<Sh>},
+      {"sw", make<Sw>},
+      {"lb", make<Lb>},
+      {"lh", make<Lh>},
+      {"lw", make<Lw>},
+      {"beqz", make<BranchEqualZero>},
+      {"srli", make<SRLI>},
+      {"ebreak", make<EBreak>},
+      {"data", make<Data>},
+      {"la", make<La>}
+}));
+
+std::map<std::string, Register> Parser::get_register_names() {
+    std::map<std::string, Register> names;
+    for (const auto& [name, reg] : REGISTERS.all()) {
+        if (name == "fp") { break; }
+        names.emplace(name, reg);
+    }
+    return names;
+}
 
 std::vector<std::string> Parser::get_offset(const std::vector<std::string>& args) {
     std::vector<std::string> result;
@@ -35,161 +100,110 @@ std::vector<std::string> Parser::get_offset(const std::vector<std::string>& args
 }
 
 
-long Parser::get_immediate(const std::string& str) {
-    if (is_dec_number(str)) {
-        return stol(str);
-    }
-
-    if (is_char(str)) {
-        if (str.size() == 3) {
-          return str.at(1);
-        }
-        if (str.size() == 4) {
-          switch (str.at(2)){
-            case 'n': return '\n'; break;
-            default: throw ParserException("Wrong char: " + str);
-          }
-        }
-    }
-    if (is_hex_number(str)) {
-        std::string buffer;
-        int sign = 1;
-        if (str.at(0) == '-') {
-            buffer = str.substr(3);
-            sign = -1;
-        } else {
-            buffer = str.substr(2);
+// sign, then 0x or 0b or nothing and the digits, or a char; the value is computed while the string is checked
+Parser::Immediate Parser::classify_immediate(std::string_view str, long& value) {
+    if (!str.empty() && str[0] == '\'') {
+        if (str.size() == 3 && str[2] == '\'') {
+            value = str[1];
+            return Immediate::Value;
         }
-        return sign * stol(buffer, nullptr, 16);
-    }
-    if (is_binary_number(str)) {
-        std::string buffer;
-        int sign = 1;
-        if (str.at(0) == '-') {
-            buffer = str.substr(3);
-            sign = -1;
-        } else {
-            buffer = str.substr(2);
+        if (str.size() == 4 && str[1] == '\\') {
+            if (str[2] != 'n') {
+                return Immediate::WrongChar;
+            }
+            value = '\n';
+            return Immediate::Value;
         }
-        return sign * stol(buffer, nullptr, 2);
+        return Immediate::None;
     }
-    throw ParserException("Wrong number: " + str);
-};
-
 
-bool Parser::is_binary_char(char c) {
-    if (c != '0' && c != '1') {
-        return false;
+    size_t i = 0;
+    const bool negative = !str.empty() && str[0] == '-';
+    i += negative;
+    unsigned base = 10;
+    if (str.size() - i > 2 && str[i] == '0' && (str[i + 1] == 'x' || str[i + 1] == 'b')) {
+        base = str[i + 1] == 'x' ? 16 : 2;
+        i += 2;
     }
-    return true;
-}
-
-
-bool Parser::is_hex_char(char c) {
-    if ('0' <= c && c <= '9') {
-        return true;
-    }
-    if ('a' <= c && c <= 'f') {
-        return true;
+    if (i == str.size()) {
+        return Immediate::None;
     }
-    if ('A' <= c && c <= 'F') {
-        return true;
-    }
-    return false;
-}
-
-
-bool Parser::is_binary_number(const std::string& str) {
-    if (str.empty() || str.size() <= 2) return false;
-    auto iter = str.begin();
 
-    if (str.front() == '-') {
-        if (str.size() <=3) {
-            return false;
+    unsigned long magnitude = 0;
+    bool overflow = false;
+    for (; i < str.size(); i++) {
+        const char c = str[i];
+        unsigned digit;
+        if ('0' <= c && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && 'a' <= c && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (base == 16 && 'A' <= c && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return Immediate::None;
+        }
+        if (digit >= base) {
+            return Immediate::None;
         }
-        iter++;
+        overflow |= magnitude > (ULONG_MAX - digit) / base;
+        magnitude = magnitude * base + digit;
     }
-    
-
-    if (*iter == '0' && *++iter == 'b') {
-        iter++;
-        return all_of(iter, str.end(), Parser::is_binary_char);
+    if (overflow || magnitude > (unsigned long) LONG_MAX + negative) {
+        return Immediate::OutOfRange;
     }
-    return false;
+    value = negative ? (long) -magnitude : (long) magnitude;
+    return Immediate::Value;
 }
 
 
-bool Parser::is_hex_number(const std::string& str) {
-    if (str.empty() || str.size() <= 2) return false;
-    auto iter = str.begin();
-
-    if (str.front() == '-') {
-        if (str.size() <=3) {
-            return false;
-        }
-        iter++;
-    }
-
-    if (*iter == '0' && *++iter == 'x') {
-        iter++;
-        return all_of(iter, str.end(), Parser::is_hex_char);
+bool Parser::parse_immediate(std::string_view str, long& value) {
+    switch (classify_immediate(str, value)) {
+        case Immediate::Value: return true;
+        case Immediate::None: return false;
+        case Immediate::WrongChar: throw ParserException("Wrong char: " + std::string(str));
+        case Immediate::OutOfRange: throw ParserException("Number out of range: " + std::string(str));
     }
     return false;
 }
 
 
-bool Parser::is_dec_number(const std::string& str) {
-    if (str.empty()) return false;
-    auto iter = str.begin();
-
-    if (str.front() == '-') {
-        if (str.size() == 1) {
-            return false;
-        }
-        iter++;
-    }
-    return all_of(iter, str.end(), ::isdigit);
-}
-
-bool Parser::is_char(const std::string& str) {
-    if (str.size() >= 3 && str.at(0) == '\'') {
-        if (str.size() == 3 && str.at(2) == '\'') {
-            return true;
-        }
-        if (str.size() == 4 && str.at(1) == '\\') {
-            return true;
-        }
+long Parser::get_immediate(std::string_view str) {
+    long value;
+    if (!parse_immediate(str, value)) {
+        throw ParserException("Wrong number: " + std::string(str));
     }
-    return false;
+    return value;
 }
 
 
-bool Parser::is_number(const std::string& str) {
-    return is_binary_number(str) || is_hex_number(str) || is_dec_number(str) || is_char(str);
+bool Parser::is_number(std::string_view str) {
+    long value;
+    return classify_immediate(str, value) != Immediate::None;
 }
 
 
-Register Parser::get_register(const std::string &str) {
-    if (registers_names.find(str) != registers_names.end()) {
-        return registers_names[str];
+Register Parser::get_register(std::string_view str) {
+    if (const Register* reg = REGISTERS.find(str)) {
+        return *reg;
     }
-    throw ParserException("invalid register: " + str);
+    throw ParserException("invalid register: " + std::string(str));
 }
 
-Instruction* Parser::get_instruction(const std::string& str, std::vector<std::string> args) {
-    if (func.find(str) != func.end()) {
-        return func[str](args);
+Instruction* Parser::get_instruction(std::string_view str, std::vector<std::string> args) {
+    if (const InstructionFactory* make = MNEMONICS.find(str)) {
+        return (*make)(std::move(args));
     }
-    throw ParserException("invalid instruction: " + str);
+    throw ParserException("invalid instruction: " + std::string(str));
 }
 
-void Parser::delete_instructions(vector<Instruction*> instructions) {
+void Parser::delete_instructions(const std::vector<Instruction*>& instructions) {
     for (Instruction* instruction : instructions) {
         delete instruction;
     }
 }
 
-std::vector<std::string> Parser::check_syntax(std::vector<std::string> args_tokens, std::string& instruction_token, int line) {
+std::vector<std::string> Parser::check_syntax(const std::vector<std::string_view>& args_tokens, std::string_view instruction_token, int line) {
     std::string error_message = "Syntax error in line ";
     if (args_tokens.size() != 0 && args_tokens[args_tokens.size() - 1] == ",") {
         throw ParserException(error_message + StringUtils::concat(" ",  args_tokens));
@@ -197,27 +211,32 @@ std::vector<std::string> Parser::check_syntax(std::vector<std::string> args_toke
     std::vector<std::string> result;
     for (int i = 0; i < args_tokens.size(); i++) {
         if (i % 2 == 0) {
-            result.push_back(args_tokens[i]);
+            result.emplace_back(args_tokens[i]);
         } else {
             if (args_tokens[i] != ",") {
                 // can be double commma, missing comma
                 throw ParserException(error_message + std::to_string(line) + ": " +
-                                      instruction_token + " " + StringUtils::concat(" ",  args_tokens));
+                                      std::string(instruction_token) + " " + StringUtils::concat(" ",  args_tokens));
             }
         }
     }
     return result;
 }
 
-std::vector<Instruction*> Parser::get_instructions() {
+std::vector<std::string> Parser::check_syntax(const std::vector<std::string>& args_tokens, std::string_view instruction_token, int line) {
+    return check_syntax(std::vector<std::string_view>(args_tokens.begin(), args_tokens.end()), instruction_token, line);
+}
+
+// the lines of one lexer, the first of them is line first_line of the preprocessed program
+std::vector<Instruction*> Parser::parse_lines(Lexer& lines, int first_line) const {
     std::vector<Instruction*> instruction_vector;
     Instruction* instruction;
-    int line_counter = 0;
+    int line_counter = first_line;
 
-    std::string instruction_token = lexer.get_next_token();
+    std::string_view instruction_token = lines.get_next_token();
     while (instruction_token != "eof") {
         int current_line = from_inparse_to_in[line_counter] + 1;
-        std::vector<std::string> args_tokens = check_syntax(lexer.get_tokens_until_end_line(), instruction_token, current_line);
+        std::vector<std::string> args_tokens = check_syntax(lines.get_tokens_until_end_line(), instruction_token, current_line);
         try {
             instruction = get_instruction(instruction_token, args_tokens);
         } catch (const ParserException& e) {
@@ -226,17 +245,115 @@ std::vector<Instruction*> Parser::get_instructions() {
                                   e.get_message());
         } 
 
-        if (label_instructions.find(instruction_token) != label_instructions.end()) {   // need to check label existence
-            if (labels.find(args_tokens.back()) == labels.end()) {
+        auto label_instruction = dynamic_cast<LabelInstruction*>(instruction);
+        if (label_instruction != nullptr) {   // need to check label existence and bind its index
+            auto label = labels.find(label_instruction->label);
+            if (label == labels.end()) {
+                delete instruction;
                 delete_instructions(instruction_vector);
                 throw ParserException("Using non-existent label in line " + std::to_string(current_line) +  ": " + 
                                       args_tokens.back());
             }
+            label_instruction->target = label->second;
         }
         instruction_vector.push_back(instruction);
-        instruction_token = lexer.get_next_token();
+        instruction_token = lines.get_next_token();
         line_counter++;
     }
     return instruction_vector;
 }
 
+std::vector<Instruction*> Parser::get_instructions(unsigned threads) {
+    // labels and the line map are fixed by the preprocessor, so every line parses on its own
+    threads = std::min<size_t>(threads, lexer.remaining() / MIN_BYTES_PER_THREAD);
+    if (threads < 2) {
+        return parse_lines(lexer, 0);
+    }
+
+    std::vector<std::pair<Lexer, int>> chunks = lexer.split(threads);
+    std::vector<std::vector<Instruction*>> parsed(chunks.size());
+    std::vector<std::exception_ptr> errors(chunks.size());
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks.size(); i++) {
+        workers.emplace_back([&, i] {
+            try {
+                parsed[i] = parse_lines(chunks[i].first, chunks[i].second);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    try {
+        parsed[0] = parse_lines(chunks[0].first, chunks[0].second);
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // a chunk stops at its first error, so the error of the first failed chunk is the earliest one
+    for (std::exception_ptr& error : errors) {
+        if (error) {
+            for (std::vector<Instruction*>& instructions : parsed) {
+                delete_instructions(instructions);
+            }
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t total = 0;
+    for (const std::vector<Instruction*>& instructions : parsed) {
+        total += instructions.size();
+    }
+    std::vector<Instruction*> instruction_vector;
+    instruction_vector.reserve(total);
+    for (const std::vector<Instruction*>& instructions : parsed) {
+        instruction_vector.insert(instruction_vector.end(), instructions.begin(), instructions.end());
+    }
+    return instruction_vector;
+}
+
+
+std::vector<DecodedInstruction> Parser::get_lazy_program() {
+    std::string_view text = lexer.text();
+    std::vector<DecodedInstruction> program;
+    program.reserve(from_inparse_to_in.size());
+    for (size_t offset = 0; offset < text.size(); offset = text.find('\n', offset) + 1) {
+        if (text.substr(offset).starts_with("data ")) {
+            program.push_back(parse_line(program.size(), offset));
+        } else {
+            program.push_back({Opcode::Unparsed});
+            program.back().immediate = offset;
+        }
+    }
+    return program;
+}
+
+
+DecodedInstruction Parser::parse_line(size_t index, long offset) const {
+    std::string_view text = lexer.text();
+    std::string_view line = text.substr(offset, text.find('\n', offset) + 1 - offset);
+    std::string deferred;
+    if (line == "\n" && source_lines != nullptr) {
+        Preprocessor::plain_line((*source_lines)[from_inparse_to_in[index]], deferred);
+        line = deferred;
+    }
+    Lexer lines(line);
+    std::vector<Instruction*> instructions = parse_lines(lines, index);
+    DecodedInstruction instruction = instructions[0]->decode();
+    delete_instructions(instructions);
+    return instruction;
+}
+
+
+std::vector<DecodedInstruction> Parser::get_program() {
+    std::vector<Instruction*> instructions = get_instructions();
+    std::vector<DecodedInstruction> program;
+    program.reserve(instructions.size());
+    for (Instruction* instruction : instructions) {
+        program.push_back(instruction->decode());
+    }
+    delete_instructions(instructions);
+    return program;
+}
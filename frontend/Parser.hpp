@@ -8,6 +8,8 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "../instructions/instructions.hpp"
@@ -21,57 +23,20 @@
 class Parser {
   Lexer lexer;
   std::map<std::string, int>& labels;
-  static std::map<std::string, Register> registers_names;
 
-  std::map<std::string, function<Instruction* (std::vector<std::string> args)>> func = {
-      {"add", [](std::vector<std::string> args) { return new Add(args); }},
-      {"li", [](std::vector<std::string> args) { return new Li(args); }},
-      {"addi", [](std::vector<std::string> args) { return new Addi(args); }},
-      {"and", [](std::vector<std::string> args) { return new And(args); }},
-      {"mv", [](std::vector<std::string> args) { return new Mv(args); }},
-      {"or", [](std::vector<std::string> args) { return new Or(args); }},
-      {"sll", [](std::vector<std::string> args) { return new SLL(args); }},
-      {"srl", [](std::vector<std::string> args) { return new SRL(args); }},
-      {"sub", [](std::vector<std::string> args) { return new Sub(args); }},
-      {"xor", [](std::vector<std::string> args) { return new Xor(args); }},
-      {"ecall", [](std::vector<std::string> args) { return new Ecall(args); }},
-      {"call", [](std::vector<std::string> args) { return new Call(args); }},
-      {"j", [](std::vector<std::string> args) { return new Jump(args); }},
-      {"jal", [](std::vector<std::string> args) { return new JumpAndLink(args); }},
-      {"beq", [](std::vector<std::string> args) { return new BranchEqual(args); }},
-      {"bgt", [](std::vector<std::string> args) { return new BranchGreaterThen(args); } },
-      {"bne", [](std::vector<std::string> args) { return new BranchNotEqual(args); }},
-      {"blt", [](std::vector<std::string> args) { return new BranchLessThen(args); }},
-      {"bge", [](std::vector<std::string> args) { return new BranchGreaterEqual(args); }},
-      {"ret", [](std::vector<std::string> args) { return new Return(args); }},
-      {"slli", [](std::vector<std::string> args) { return new SLLI(args); }},
-      {"sb", [](std::vector<std::string> args) { return new Sb(args); }},
-      {"sh", [](std::vector<std::string> args) { return new Sh(args); }},
-      {"sw", [](std::vector<std::string> args) { return new Sw(args); }},
-      {"lb", [](std::vector<std::string> args) { return new Lb(args); }},
-      {"lh", [](std::vector<std::string> args) { return new Lh(args); }}, 
-      {"lw", [](std::vector<std::string> args) { return new Lw(args); }},
-      {"beqz", [](std::vector<std::string> args) { return new BranchEqualZero(args); }},
-      {"srli", [](std::vector<std::string> args) { return new SRLI(args); }},
-      {"ebreak", [](std::vector<std::string> args) { return new EBreak(args); }},
-      {"data", [](std::vector<std::string> args) { return new Data(args); }},
-      {"la", [](std::vector<std::string> args) { return new La(args); }}
-  };
+  // below this much preprocessed text per thread, starting threads costs more than parsing
+  static constexpr size_t MIN_BYTES_PER_THREAD = 64 * 1024;
 
-  std::set<std::string> label_instructions = {"j", "jal", "beq", "bgt", "bne", "blt", "beqz", "bge", "la"};
+  static void delete_instructions(const std::vector<Instruction*>& instructions);
+  std::vector<Instruction*> parse_lines(Lexer& lines, int first_line) const;
+  static Instruction* get_instruction(std::string_view str, std::vector<std::string> args);
 
-  void delete_instructions(std::vector<Instruction* > instructions);
-  Instruction* get_instruction(const std::string& str, std::vector<std::string> args);
-
-  static bool is_binary_number(const std::string& str);
-  static bool is_hex_number(const std::string& str);
-  static bool is_dec_number(const std::string& str);
-  static bool is_char(const std::string& str);
-
-  static bool is_binary_char(char c);
-  static bool is_hex_char(char c);
+  enum class Immediate { None, Value, WrongChar, OutOfRange };
+  static Immediate classify_immediate(std::string_view str, long& value);
 
   std::vector<int>& from_inparse_to_in;
+  // the source a line deferred by the preprocessor is read from, see set_source_lines()
+  const std::vector<std::string>* source_lines = nullptr;
 
   friend Interpreter;
 
@@ -79,15 +44,25 @@ public:
   Parser(Lexer lexer_, std::map<std::string, int>& labels_, std::vector<int>& inparse_to_in_): lexer(lexer_), labels(labels_), from_inparse_to_in(inparse_to_in_)  {}
   
 
-  static std::map<std::string, Register> get_register_names() {
-    return registers_names;
-  }
+  // the ABI names, without the aliases x0-x31 and fp
+  static std::map<std::string, Register> get_register_names();
 
-  static std::vector<std::string> check_syntax(std::vector<std::string> args_tokens, std::string& instruction_token, int line);
+  static std::vector<std::string> check_syntax(const std::vector<std::string_view>& args_tokens, std::string_view instruction_token, int line);
+  static std::vector<std::string> check_syntax(const std::vector<std::string>& args_tokens, std::string_view instruction_token, int line);
 
-  std::vector<Instruction*> get_instructions();
-  static Register get_register(const std::string& str);
+  // threads parse chunks of lines side by side, the order of instructions and errors is that of one thread
+  std::vector<Instruction*> get_instructions(unsigned threads = std::thread::hardware_concurrency());
+  std::vector<DecodedInstruction> get_program();
+  // --lazy: data is parsed, every other line becomes an Opcode::Unparsed record
+  // for parse_line(), which the interpreter calls when the line is first executed
+  std::vector<DecodedInstruction> get_lazy_program();
+  DecodedInstruction parse_line(size_t index, long offset) const;
+  // lines of a Preprocessor::defer_plain_lines() pass, their text is that of their source line
+  void set_source_lines(const std::vector<std::string>& lines) { source_lines = &lines; }
+  static Register get_register(std::string_view str);
   static std::vector<std::string> get_offset(const std::vector<std::string>& args);
-  static long get_immediate(const std::string& str);
-  static bool is_number(const std::string& str);
+  static long get_immediate(std::string_view str);
+  // false if str is no immediate, throws if it is one that does not fit
+  static bool parse_immediate(std::string_view str, long& value);
+  static bool is_number(std::string_view str);
 };
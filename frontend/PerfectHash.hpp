@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include "../content_hash.hpp"
+
+/*  A table of fixed string keys built by the compiler. The seed of the hash is
+    searched until every key has a slot of its own, so a lookup is one hash,
+    one slot and one compare, without probing and without any construction at
+    run time. A key given twice never gets a slot of its own and fails the
+    build. */
+template <typename Value, size_t N>
+class PerfectHash {
+  public:
+    using Entry = std::pair<std::string_view, Value>;
+
+  private:
+    static_assert(N < 255, "slots hold the index of an entry in a byte");
+    static constexpr size_t SLOTS = std::bit_ceil(N) * 8;
+    static constexpr unsigned char EMPTY = 255;
+    static constexpr unsigned MAX_ATTEMPTS = 1 << 16;
+
+    std::array<Entry, N> entries;
+    std::array<unsigned char, SLOTS> slots = {};
+    unsigned long seed = 0;
+
+    static constexpr size_t slot(std::string_view key, unsigned long seed) {
+        const unsigned long hash = content_hash(key, seed);
+        return (hash ^ (hash >> 29)) & (SLOTS - 1);
+    }
+
+  public:
+    consteval PerfectHash(const std::array<Entry, N>& entries_): entries(entries_) {
+        for (unsigned attempt = 0; attempt < MAX_ATTEMPTS; attempt++, seed++) {
+            slots.fill(EMPTY);
+            bool perfect = true;
+            for (size_t i = 0; i < N && perfect; i++) {
+                unsigned char& index = slots[slot(entries[i].first, seed)];
+                perfect = index == EMPTY;
+                index = i;
+            }
+            if (perfect) {
+                return;
+            }
+        }
+        throw "no perfect hash for the keys, is a key given twice?";
+    }
+
+    // the value of key, nullptr if key is none of the keys
+    constexpr const Value* find(std::string_view key) const {
+        const unsigned char index = slots[slot(key, seed)];
+        return index != EMPTY && entries[index].first == key ? &entries[index].second : nullptr;
+    }
+
+    constexpr const std::array<Entry, N>& all() const { return entries; }
+};
+
+template <typename Value, size_t N>
+PerfectHash(const std::array<std::pair<std::string_view, Value>, N>&) -> PerfectHash<Value, N>;
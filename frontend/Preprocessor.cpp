@@ -1,24 +1,18 @@
 #include "Preprocessor.hpp"
+#include "ModuleCache.hpp"
 #include "../consts.hpp"
 
-
-void Preprocessor::string_replace(std::string& input, const std::string& src, const std::string& dst) {
-    size_t pos = input.find(src);
-    while(pos != std::string::npos) {
-        input.replace(pos, src.size(), dst);
-        size_t new_pos = input.find(src, pos);
-        if (pos == new_pos) break;
-        pos = new_pos;
-    }
-}
+#include <algorithm>
+#include <cstdlib>
 
 
-std::vector<std::string> Preprocessor::split_and_delete_comments(const std::string& s) {
-    std::vector<std::string> result;
-    std::stringstream input(s);
-    std::string item;
-
-    while (getline (input, item, ' ')) {
+// words between spaces, a word starting with a tab is dropped and one starting with # ends the line
+std::vector<std::string_view> Preprocessor::split_and_delete_comments(std::string_view s) {
+    std::vector<std::string_view> result;
+    while (!s.empty()) {
+        const size_t end = s.find(' ');
+        std::string_view item = s.substr(0, end);
+        s.remove_prefix(end == std::string_view::npos ? s.size() : end + 1);
         if (item.empty() || item[0] == '\t') { continue; }         // unused space
         if (item[0] == '#') { return result; }                     // comment start
         result.push_back(item);
@@ -27,83 +21,241 @@ std::vector<std::string> Preprocessor::split_and_delete_comments(const std::stri
 }
 
 
-void Preprocessor::delete_commas(std::vector<std::string>& line) {
-    for (auto& word: line) { string_replace(word, ",", ""); }
-}
-
-
-void Preprocessor::replace(std::string& str, std::map<std::string, std::string> replace_map) {
-    for(auto& pair : replace_map) {
-        string_replace(str, pair.first, pair.second);
+// calls f(unit, is_word) for the names and the separators , ( ) of token in order, a quoted literal is one word
+template <typename F>
+static void for_each_unit(std::string_view token, F f) {
+    if (token.front() == '\'' || token.front() == '"') {
+        f(token, true);
+        return;
+    }
+    while (!token.empty()) {
+        const size_t end = token.find_first_of(",()");
+        if (end != 0) {
+            f(token.substr(0, end), true);
+            if (end == std::string_view::npos) { return; }
+        }
+        f(token.substr(end, 1), false);
+        token.remove_prefix(end + 1);
     }
 }
 
-bool Preprocessor::is_label(std::string& token) {
+
+bool Preprocessor::is_label(std::string_view token) {
     return token[token.size() - 1] == ':';
 }
 
-void Preprocessor::add_label(std::string& label, int lines_counter) {
+void Preprocessor::add_label(std::string label, int lines_counter) {
     label.erase(label.size() - 1, 1);
     if (labels.find(label) != labels.end()) {
-        in.close();
         throw PreprocessorException("Name conflict, need to rename label: " + label);
     }
     labels[label] = lines_counter;
 }
 
-std::map<std::string, std::string> Preprocessor::create_replace_labels(std::vector<std::string>& macro_labels, std::string num, std::string name) {
-    std::map<std::string, std::string> replace_labels;
-    for (std::string label: macro_labels) {
-        label.erase(label.size() - 1, 1);
-        replace_labels[label] = name + "_" + num + "_" + label;
+// the words from first on joined by single spaces
+std::vector<Preprocessor::Piece> Preprocessor::to_pieces(const std::vector<std::string_view>& words, size_t first) {
+    std::vector<Piece> pieces;
+    for (size_t i = first; i < words.size(); i++) {
+        if (i != first) { pieces.push_back({Piece::Text, " "}); }
+        for_each_unit(words[i], [&pieces](std::string_view unit, bool word) {
+            pieces.push_back({word ? Piece::Word : Piece::Text, std::string(unit)});
+        });
     }
-    return replace_labels;
+    return pieces;
 }
 
-void Preprocessor::inline_macros(std::vector<std::string>& input_line, int& counter_in_parse, bool write_to_file, Macros* m_data) {
-    std::string first = input_line.front();
-    int num = macros[first].instances++;         // get number to create custom label name 
-    std::map<std::string, std::string> replace_labels = create_replace_labels(macros[first].macros_labels, std::to_string(num), first);
-    delete_commas(input_line);
-    input_line.erase(input_line.begin());
-    if (macros[first].params.size() != input_line.size()) {
-        in.close();
-        throw PreprocessorException("invalid args amount for macro: " + first);
+// the value of an .eqv name, names defined as names are followed
+std::string_view Preprocessor::resolve(std::string_view word) const {
+    for (size_t depth = 0; depth < eqv.size(); depth++) {
+        auto it = eqv.find(word);
+        if (it == eqv.end()) { break; }
+        word = it->second;
     }
+    return word;
+}
 
-    for (size_t j = 0; j < macros[first].macros_lines.size(); j++) {
-        std::string line = macros[first].macros_lines[j];
-        if (is_label(line)) {
-            line = first + "_" + std::to_string(num) + "_" + line;
-            if (write_to_file) {
-              add_label(line, counter_in_parse);
-            } else {
-              m_data->macros_lines.push_back(line);
-            }
+// an instruction line: the words joined by single spaces, without .eqv they go straight into out
+void Preprocessor::append_line(std::string& out, const std::vector<std::string_view>& words) const {
+    for (size_t i = 0; i < words.size(); i++) {
+        if (i != 0) { out += ' '; }
+        if (eqv.empty()) {
+            out += words[i];
             continue;
         }
-        for (size_t i = 0; i < macros[first].params.size(); i++) {
-            string_replace(line, macros[first].params[i], input_line[i]);
+        for_each_unit(words[i], [this, &out](std::string_view unit, bool word) {
+            out += word ? resolve(unit) : unit;
+        });
+    }
+    out += '\n';
+}
+
+// a line that is neither empty, a comment, a directive, a label nor a macro call, from its first word
+bool Preprocessor::is_plain(std::string_view line) const {
+    while (!line.empty()) {
+        const size_t end = line.find(' ');
+        std::string_view item = line.substr(0, end);
+        line.remove_prefix(end == std::string_view::npos ? line.size() : end + 1);
+        if (item.empty() || item[0] == '\t') { continue; }
+        return item[0] != '#' && item[0] != '.' && !is_label(item) && macros.find(item) == macros.end();
+    }
+    return false;
+}
+
+// the output line of a deferred line, as append_line() without .eqv
+void Preprocessor::plain_line(std::string_view line, std::string& out) {
+    std::vector<std::string_view> words = split_and_delete_comments(line);
+    for (size_t i = 0; i < words.size(); i++) {
+        if (i != 0) { out += ' '; }
+        out += words[i];
+    }
+    out += '\n';
+}
+
+// the lines of the macro called by call either into inparse or, inside a definition, into m_data
+void Preprocessor::inline_macros(const std::vector<std::string_view>& call, int& counter_in_parse, int call_line, Macros* m_data) {
+    const std::string name(call.front());
+    Macros& macro = macros.find(name)->second;
+    const std::string prefix = name + "_" + std::to_string(macro.instances++) + "_";   // custom label names
+
+    // the arguments split between commas, inside a definition its parameters stay slots
+    std::vector<std::vector<Piece>> args;
+    for (size_t i = 1; i < call.size(); i++) {
+        std::string_view word = call[i];
+        while (!word.empty()) {
+            const size_t end = word.find(',');
+            if (end != 0) {
+                args.push_back(to_pieces({word.substr(0, end)}, 0));
+            }
+            word.remove_prefix(end == std::string_view::npos ? word.size() : end + 1);
         }
-        replace(line, eqv);
+    }
+    if (macro.params.size() != args.size()) {
+        throw PreprocessorException("invalid args amount for macro: " + name);
+    }
 
-        std::vector<std::string> buffer = StringUtils::split(line, ' ');
-        if (buffer.size() > 1) {
-            int last = buffer.size() - 1;
-            if (replace_labels.find(buffer[last]) !=  replace_labels.end()) {
-                buffer[last] = replace_labels[buffer[last]];
+    if (m_data != nullptr) {
+        for (auto& arg : args) {
+            for (Piece& piece : arg) {
+                for (size_t p = 0; piece.kind == Piece::Word && p < m_data->params.size(); p++) {
+                    if (piece.text == m_data->params[p]) { piece = {Piece::Param, "", (int) p}; }
+                }
+            }
+        }
+        // the labels of this instance become labels of the macro being defined
+        const int base = m_data->labels.size();
+        for (const std::string& label : macro.labels) {
+            m_data->labels.push_back(prefix + label);
+        }
+        for (const MacroLine& line : macro.lines) {
+            MacroLine copy = {{}, call_line, line.defines_label};
+            for (const Piece& piece : line.pieces) {
+                if (piece.kind == Piece::Param) {
+                    copy.pieces.insert(copy.pieces.end(), args[piece.index].begin(), args[piece.index].end());
+                } else if (piece.kind == Piece::Label) {
+                    copy.pieces.push_back({Piece::Label, "", base + piece.index});
+                } else {
+                    copy.pieces.push_back(piece);
+                }
+            }
+            m_data->lines.push_back(std::move(copy));
+        }
+        return;
+    }
+
+    for (const MacroLine& line : macro.lines) {
+        if (line.defines_label) {
+            add_label(prefix + macro.labels[line.pieces.front().index] + ":", counter_in_parse);
+            continue;
+        }
+        for (const Piece& piece : line.pieces) {
+            switch (piece.kind) {
+                case Piece::Text: inparse += piece.text; break;
+                case Piece::Word: inparse += resolve(piece.text); break;
+                case Piece::Label: inparse += prefix; inparse += macro.labels[piece.index]; break;
+                case Piece::Param:
+                    for (const Piece& arg : args[piece.index]) {
+                        inparse += arg.kind == Piece::Word ? resolve(arg.text) : std::string_view(arg.text);
+                    }
+                    break;
             }
         }
-        line = StringUtils::concat(" ", buffer);
+        inparse += '\n';
+        counter_in_parse++;
+        from_inparse_to_in.push_back(line.line < 0 ? call_line : line.line);
+    }
+}
+
+
+// the module of a quoted path relative to this file, its lines all map to include_line
+void Preprocessor::include(std::string_view name, int& counter_in_parse, int include_line) {
+    if (name.size() < 3 || name.front() != '"' || name.back() != '"') {
+        throw PreprocessorException("path of .include needs quotes: " + std::string(name));
+    }
+    std::string path(name.substr(1, name.size() - 2));
+    const size_t slash = file.rfind('/');
+    if (path.front() != '/' && slash != std::string::npos) {
+        path = file.substr(0, slash + 1) + path;
+    }
+    char* real = realpath(path.c_str(), nullptr);
+    if (real == nullptr) {
+        throw PreprocessorException("Can not include: " + path);
+    }
+    path = real;
+    free(real);
+
+    std::vector<std::string> chain = including;
+    real = realpath(file.c_str(), nullptr);
+    chain.emplace_back(real != nullptr ? real : file);
+    free(real);
+    if (std::find(chain.begin(), chain.end(), path) != chain.end()) {
+        throw PreprocessorException("Circular .include: " + path);
+    }
+
+    const Module* module = find_module(path, cache_dir);
+    if (module == nullptr) {
+        Preprocessor preprocessor(path, cache_dir, std::move(chain));
+        try {
+            preprocessor.preprocess();
+        } catch (const PreprocessorException& e) {
+            throw PreprocessorException("In " + path + ": " + e.get_message());
+        }
+        module = &store_module(path, preprocessor.to_module(), cache_dir);
+    }
+
+    from_in_to_inparse.push_back(module->lines != 0 ? counter_in_parse : -2);
+    for (const auto& [label, index] : module->labels) {
+        add_label(label + ":", counter_in_parse + index);
+    }
+    for (const auto& [key, value] : module->eqv) {
+        eqv.insert_or_assign(key, value);
+    }
+    for (const auto& [macro_name, macro] : module->macros) {
+        macros.insert_or_assign(macro_name, macro);
+    }
+    inparse += module->inparse;
+    from_inparse_to_in.insert(from_inparse_to_in.end(), module->lines, include_line);
+    counter_in_parse += module->lines;
+    included.insert(included.end(), module->files.begin(), module->files.end());
+}
 
-        if (write_to_file) {
-          counter_in_parse++;
-          from_inparse_to_in.push_back(macros[first].start_line + j);
-          inparse << line << std::endl;
-        } else {
-          m_data->macros_lines.push_back(line);  
+Preprocessor::Module Preprocessor::to_module() {
+    Module module;
+    module.inparse = std::move(inparse);
+    module.lines = from_inparse_to_in.size();
+    module.labels.assign(labels.begin(), labels.end());
+    module.eqv.assign(eqv.begin(), eqv.end());
+    for (auto& [name, macro] : macros) {
+        for (MacroLine& line : macro.lines) {
+            line.line = -1;
         }
+        module.macros.emplace_back(name, std::move(macro));
+    }
+    IncludedFile self;
+    if (stamp_file(file, self)) {
+        module.files.push_back(std::move(self));
     }
+    module.files.insert(module.files.end(), included.begin(), included.end());
+    return module;
 }
 
 
@@ -112,144 +264,188 @@ void Preprocessor::inline_macros(std::vector<std::string>& input_line, int& coun
 /* 
 empty line or comment                  -> -1  
 . definition (.macro .eqv .section)    -> -2
+  or an .include without lines
 label                                  -> -3
 */
 
 
 
 
+std::vector<std::string>& Preprocessor::all_lines_in() {
+    if (all_lines.empty()) {
+        all_lines.assign(source.lines().begin(), source.lines().end());
+    }
+    return all_lines;
+}
+
 void Preprocessor::preprocess() {
-    in.open(file);
+    const std::vector<std::string_view>& lines = source.lines();
     int counter_in_parse = 0;        // counter for lines in _in.parse
     int counter_in = -1;             // counter for lines in in.txt
+    inparse.reserve(source.text().size() + source.text().size() / 8);
 
-    if (in.is_open()) {
-        std::string current_line;
-        while (getline(in, current_line)) { 
-            counter_in++;
-            if (current_line.empty() || current_line[0] == '#') {
-                from_in_to_inparse.push_back(-1);                  // comment or empty line -> -1 
-                continue;
-            }
-            std::vector<std::string> buf = split_and_delete_comments(current_line);
-            if (buf.empty()) { 
-                from_in_to_inparse.push_back(-1); 
-                continue; 
-            }
-            std::string first = buf.front();
-            if (macros.find(first) != macros.end()) {
-                from_in_to_inparse.push_back(counter_in_parse);            // pointer to start of the macros
-                inline_macros(buf, counter_in_parse, true, nullptr);
-                continue;
-            }
-            if (first.at(0) == '.') {  
-                if (first == ".macro") {
-                    from_in_to_inparse.push_back(-2); 
-                    Macros m_data;
-                    m_data.start_line = counter_in + 1;
-                    std::string name = buf[1];
-                    delete_commas(buf);
-                    buf.erase(buf.begin(), buf.begin() + 2);                      // delete .macro and macro_name
-                    m_data.params = buf;                                          // many parameters
-                    std::vector<std::string> macros_labels;
-                    while (getline(in, current_line)) {
-                      counter_in++;
-                      from_in_to_inparse.push_back(-2); 
-                      std::vector<std::string> in_buf = split_and_delete_comments(current_line);  // delete comments
-                      if (in_buf.empty()) { continue; }
-                      if (in_buf.front() == ".end_macro") { break; }
-                      if (in_buf.size() == 1 && is_label(in_buf.front())) {
-                        m_data.macros_labels.push_back(in_buf.front());
-                        m_data.macros_lines.push_back(in_buf.front());  
-                        continue;
-                      }
-                      if (macros.find(in_buf.front()) != macros.end()) {
-                        inline_macros(in_buf, counter_in_parse, false, &m_data);
-                        continue;
-                      }
-                      m_data.macros_lines.push_back(StringUtils::concat(" ", in_buf)); 
-                    }
-                    macros[name] = m_data;
-                } else if (first == ".eqv") {
-                    from_in_to_inparse.push_back(-2); 
-                    if (buf.size() == 3) {
-                        eqv[buf[1]] = buf[2];    // name : string to replace
-                    } else {
-                        in.close();
-                        throw PreprocessorException("invalid definition: " + StringUtils::concat(" ", buf));
-                    } 
-                } else if (first == ".section") {
-                    from_in_to_inparse.push_back(-2); 
-                    if (buf.size() < 2) {
-                        throw PreprocessorException("Section not declared");
+    while (counter_in + 1 < (int) lines.size()) {
+        std::string_view current_line = lines[++counter_in];
+        if (current_line.empty() || current_line[0] == '#') {
+            from_in_to_inparse.push_back(-1);                  // comment or empty line -> -1 
+            continue;
+        }
+        if (defer && eqv.empty() && is_plain(current_line)) {
+            from_in_to_inparse.push_back(counter_in_parse);
+            from_inparse_to_in.push_back(counter_in);
+            counter_in_parse++;
+            inparse += '\n';
+            continue;
+        }
+        std::vector<std::string_view> buf = split_and_delete_comments(current_line);
+        if (buf.empty()) { 
+            from_in_to_inparse.push_back(-1); 
+            continue; 
+        }
+        std::string_view first = buf.front();
+        if (macros.find(first) != macros.end()) {
+            from_in_to_inparse.push_back(counter_in_parse);            // pointer to start of the macros
+            inline_macros(buf, counter_in_parse, counter_in, nullptr);
+            continue;
+        }
+        if (first.at(0) == '.') {  
+            if (first == ".macro") {
+                from_in_to_inparse.push_back(-2); 
+                if (buf.size() < 2) {
+                    throw PreprocessorException("Macro name not declared");
+                }
+                Macros m_data;
+                std::string name(buf[1]);
+                for (size_t i = 2; i < buf.size(); i++) {                      // without .macro and macro_name
+                    for_each_unit(buf[i], [&m_data](std::string_view unit, bool word) {
+                        if (word) { m_data.params.emplace_back(unit); }
+                    });
+                }
+                while (counter_in + 1 < (int) lines.size()) {
+                  current_line = lines[++counter_in];
+                  from_in_to_inparse.push_back(-2); 
+                  std::vector<std::string_view> in_buf = split_and_delete_comments(current_line);  // delete comments
+                  if (in_buf.empty()) { continue; }
+                  if (in_buf.front() == ".end_macro") { break; }
+                  if (in_buf.size() == 1 && is_label(in_buf.front())) {
+                    m_data.lines.push_back({{{Piece::Label, "", (int) m_data.labels.size()}}, counter_in, true});
+                    m_data.labels.emplace_back(in_buf.front().substr(0, in_buf.front().size() - 1));
+                    continue;
+                  }
+                  if (macros.find(in_buf.front()) != macros.end()) {
+                    inline_macros(in_buf, counter_in_parse, counter_in, &m_data);
+                    continue;
+                  }
+                  MacroLine line = {to_pieces(in_buf, 0), counter_in};
+                  for (Piece& piece : line.pieces) {
+                    for (size_t p = 0; piece.kind == Piece::Word && p < m_data.params.size(); p++) {
+                      if (piece.text == m_data.params[p]) { piece = {Piece::Param, "", (int) p}; }
                     }
-                    if (! check_section(buf[1])) {
-                        throw PreprocessorException("Section " + buf[1] + " not supported");
+                  }
+                  m_data.lines.push_back(std::move(line));
+                }
+                // operands naming a label of the body refer to the label of their instance
+                for (MacroLine& line : m_data.lines) {
+                  for (size_t i = 1; i < line.pieces.size(); i++) {
+                    Piece& piece = line.pieces[i];
+                    for (size_t l = 0; piece.kind == Piece::Word && l < m_data.labels.size(); l++) {
+                      if (piece.text == m_data.labels[l]) { piece = {Piece::Label, "", (int) l}; }
                     }
-                } else if (first == ".word") {
-                    if (buf.size() < 2) {
-                        throw PreprocessorException("No content in .word");
+                  }
+                }
+                macros[name] = std::move(m_data);
+            } else if (first == ".include") {
+                if (buf.size() != 2) {
+                    throw PreprocessorException("invalid include: " + StringUtils::concat(" ", buf));
+                }
+                include(buf[1], counter_in_parse, counter_in);
+            } else if (first == ".eqv") {
+                from_in_to_inparse.push_back(-2); 
+                if (buf.size() == 3) {
+                    eqv.insert_or_assign(std::string(buf[1]), std::string(buf[2]));    // name : string to replace
+                } else {
+                    throw PreprocessorException("invalid definition: " + StringUtils::concat(" ", buf));
+                } 
+            } else if (first == ".section") {
+                from_in_to_inparse.push_back(-2); 
+                if (buf.size() < 2) {
+                    throw PreprocessorException("Section not declared");
+                }
+                if (! check_section(buf[1])) {
+                    throw PreprocessorException("Section " + std::string(buf[1]) + " not supported");
+                }
+            } else if (first == ".word") {
+                if (buf.size() < 2) {
+                    throw PreprocessorException("No content in .word");
+                }
+                from_in_to_inparse.push_back(counter_in_parse);    // MAY BE ERROR
+                from_inparse_to_in.push_back(counter_in);
+                counter_in_parse++;
+                inparse += "data ";
+                inparse += buf[1];
+                inparse += '\n';
+            } else if (first == ".string") {
+                buf.erase(buf.begin());
+                if (buf.empty()) {
+                    throw PreprocessorException("No content in .string");
+                }
+
+                std::string content = StringUtils::concat(" ", buf);
+                content.erase(0, 1);
+                content.erase(content.size() - 1, 1);
+
+                int words_amount = (content.size() / BYTE_BITS) + 1; 
+                char* raw_content = content.data();
+                for (int i = 0; i < words_amount; i++) {
+                    int stop_index = (i == words_amount - 1) ? (content.size() % BYTE_BITS) : BYTE_BITS;
+                    long data_word = 0;
+                    for (int j = 0; j < stop_index; j++) {
+                        data_word <<= BYTE_BITS;
+                        data_word += raw_content[i * BYTE_BITS + j]; 
+                    } 
+
+                    for (int j = stop_index; j < BYTE_BITS; j++) {
+                        data_word <<= BYTE_BITS;  // * 2^8
                     }
+
                     from_in_to_inparse.push_back(counter_in_parse);    // MAY BE ERROR
                     from_inparse_to_in.push_back(counter_in);
                     counter_in_parse++;
-                    inparse << "data " + buf[1] << std::endl;     
-                } else if (first == ".string") {
-                    buf.erase(buf.begin());
-                    if (buf.empty()) {
-                        throw PreprocessorException("No content in .string");
-                    }
+                    inparse += "data " + std::to_string(data_word) + '\n';
+                }
+            } else {
+                throw PreprocessorException("not supported: " + std::string(first));
+            }     
+            continue;
+        }
 
-                    std::string content = StringUtils::concat(" ", buf);
-                    content.erase(0, 1);
-                    content.erase(content.size() - 1, 1);
-
-                    int words_amount = (content.size() / BYTE_BITS) + 1; 
-                    char* raw_content = content.data();
-                    for (int i = 0; i < words_amount; i++) {
-                        int stop_index = (i == words_amount - 1) ? (content.size() % BYTE_BITS) : BYTE_BITS;
-                        long data_word = 0;
-                        for (int j = 0; j < stop_index; j++) {
-                            data_word <<= BYTE_BITS;
-                            data_word += raw_content[i * BYTE_BITS + j]; 
-                        } 
-
-                        for (int j = stop_index; j < BYTE_BITS; j++) {
-                            data_word <<= BYTE_BITS;  // * 2^8
-                        }
-
-                        from_in_to_inparse.push_back(counter_in_parse);    // MAY BE ERROR
-                        from_inparse_to_in.push_back(counter_in);
-                        counter_in_parse++;
-                        inparse << "data " + std::to_string(data_word) << std::endl;    
-                    }
-                } else {
-                    in.close();
-                    throw PreprocessorException("not supported: " + first);
-                }     
-                continue;
-            }
+        if (buf.size() == 1 && is_label(first)) {
+            add_label(std::string(first), counter_in_parse);
+            from_in_to_inparse.push_back(-3);   
+            continue;
+        }
 
-            if (buf.size() == 1 && is_label(first)) {
-                add_label(first, counter_in_parse);
-                from_in_to_inparse.push_back(-3);   
-                continue;
-            }
+        from_in_to_inparse.push_back(counter_in_parse); 
+        from_inparse_to_in.push_back(counter_in);
+        counter_in_parse++;
+        append_line(inparse, buf);
+    }
+}
 
-            from_in_to_inparse.push_back(counter_in_parse); 
-            from_inparse_to_in.push_back(counter_in);
-            counter_in_parse++;
-            current_line = StringUtils::concat(" ", buf);
-            replace(current_line, eqv);
-            inparse << current_line << std::endl;        
-        }
+
+bool Preprocessor::preprocess_line(std::string_view line, std::string& out) const {
+    std::vector<std::string_view> buf = split_and_delete_comments(line);
+    if (buf.empty() || buf.front()[0] == '.' || macros.find(buf.front()) != macros.end()
+            || (buf.size() == 1 && is_label(buf.front()))) {
+        return false;
     }
-    in.close();
+    append_line(out, buf);
+    return true;
 }
 
 
 void Preprocessor::dump_inparse() {
     std::ofstream out("_in.parse");
-    out << inparse.str();
+    out << inparse;
     out.close();
 }
@@ -3,69 +3,119 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include "../exceptions/PreprocessorException.hpp"
+#include "Program.hpp"
+#include "SourceFile.hpp"
 #include "StringUtils.hpp"
 
 
 
 class Preprocessor {
-    std::string file;
-    std::ifstream in;
+  public:
+    // a macro body line split at the definition, expanding it is a copy with the slots filled in
+    struct Piece {
+      enum Kind { Text, Word, Param, Label };
+      Kind kind;
+      std::string text;     // Text is copied as is, a Word is looked up in .eqv on expansion
+      int index = 0;        // of the argument for Param, of the macro label for Label
+    };
+
+    struct MacroLine {
+      std::vector<Piece> pieces;
+      int line;             // in the source, the line of the call for lines of an inlined or included macro
+      bool defines_label = false;
+    };
 
     struct Macros {
       int instances = 0;
-      int start_line = 0;
       std::vector<std::string> params;
-      std::vector<std::string> macros_lines;
-      std::vector<std::string> macros_labels;
+      std::vector<std::string> labels;    // without ':', prefixed with name and instance on expansion
+      std::vector<MacroLine> lines;
     };
 
+    /*  What .include takes from a file, which is preprocessed on its own and sees
+        none of the definitions of the file including it: its output lines, its
+        labels relative to its first output line, its .eqv and its macros, whose
+        lines all map to the line of their call. files holds the file and every
+        file it includes, as they were read. */
+    struct Module {
+      std::string inparse;
+      int lines = 0;
+      std::vector<std::pair<std::string, int>> labels;
+      std::vector<std::pair<std::string, std::string>> eqv;
+      std::vector<std::pair<std::string, Macros>> macros;
+      std::vector<IncludedFile> files;
+    };
+
+  private:
+    std::string file;
+    SourceFile source;
+    // --cache: modules are also kept on disk in it
+    std::string cache_dir;
+    // the files including this one, a file including one of them is an error
+    std::vector<std::string> including;
+    std::vector<IncludedFile> included;
+    // --lazy: plain instruction lines are left to plain_line(), see defer_plain_lines()
+    bool defer = false;
+
     // .text is a read-only section containing executable code
     // .data is a read-write section containing global or static variables (.string and .word support)
     // .rodata is a read-only section containing const variables
     // .bss is a read-write section containing uninitialized data
 
-    const std::set<std::string> supported_sections = {".data", ".text", ".rodata", ".bss"};
-    bool check_section(std::string& section) {
+    const std::set<std::string, std::less<>> supported_sections = {".data", ".text", ".rodata", ".bss"};
+    bool check_section(std::string_view section) {
       return supported_sections.find(section) != supported_sections.end();
     }
 
 
     std::map<std::string, int> labels;
-    std::map<std::string, std::string> eqv;
-    std::map<std::string, Macros> macros;
+    std::unordered_map<std::string, std::string, StringUtils::Hash, std::equal_to<>> eqv;
+    std::unordered_map<std::string, Macros, StringUtils::Hash, std::equal_to<>> macros;
 
     std::vector<int> from_in_to_inparse;  
     std::vector<int> from_inparse_to_in;
     std::vector<std::string> all_lines;
-    std::stringstream inparse;
+    // the preprocessed program, one instruction per line; the lexer hands out views into it
+    std::string inparse;
 
-    static void string_replace(std::string& input, const std::string& src, const std::string& dst);
-    static void delete_commas(std::vector<std::string>& line);
-    static void replace(std::string& str, std::map<std::string, std::string> replace_map);
-
-    static std::vector<std::string> split_and_delete_comments(const std::string& s);
-    static bool is_label(std::string& token);
-    void add_label(std::string& label, int lines_counter);
-    void inline_macros(std::vector<std::string>& input_line, int& counter_in_parse, bool write_to_file, Macros* m_data);
-    std::map<std::string, std::string> create_replace_labels(std::vector<std::string>& macro_labels, std::string num, std::string name);
+    static std::vector<std::string_view> split_and_delete_comments(std::string_view s);
+    static bool is_label(std::string_view token);
+    bool is_plain(std::string_view line) const;
+    static std::vector<Piece> to_pieces(const std::vector<std::string_view>& words, size_t first);
+    std::string_view resolve(std::string_view word) const;
+    void append_line(std::string& out, const std::vector<std::string_view>& words) const;
+    void add_label(std::string label, int lines_counter);
+    void inline_macros(const std::vector<std::string_view>& call, int& counter_in_parse, int call_line, Macros* m_data);
+    void include(std::string_view name, int& counter_in_parse, int include_line);
+    Module to_module();
 
   public:
-    Preprocessor(std::string file): file(file)  {
-      in.open(file);
-      std::string current_line;
-      while (getline(in, current_line)) { all_lines.push_back(current_line); }
-      in.close();
-    }
+    Preprocessor(std::string file_, std::string cache_dir_ = "", std::vector<std::string> including_ = {})
+      : file(file_), source(file_), cache_dir(std::move(cache_dir_)), including(std::move(including_)) {}
 
     std::map<std::string, int>& get_labels() { return labels; } 
     std::vector<int>& get_from_in_to_inparse() { return from_in_to_inparse; }
     std::vector<int>& get_from_inparse_to_in() { return from_inparse_to_in; }
-    std::stringstream& get_inparse() { return inparse; };
-    std::vector<std::string>& all_lines_in() { return all_lines; }
+    std::string_view get_inparse() const { return inparse; };
+    // every file pulled in by .include, directly or not
+    std::vector<IncludedFile>& get_included() { return included; }
+    // copies of the mapped lines, made on the first call
+    std::vector<std::string>& all_lines_in();
+    /*  --lazy: until the first .eqv, a plain instruction line is only told apart by
+        its first word and its output line stays empty, plain_line() of its source
+        line gives it once the line is parsed. Any other line, and with .eqv every
+        line, goes through preprocess() as usual. */
+    void defer_plain_lines() { defer = true; }
+    static void plain_line(std::string_view line, std::string& out);
     void preprocess();
+    // the output line of a plain instruction line with the .eqv of the last preprocess(),
+    // false for an empty line, a comment, a label, a directive or a macro call
+    bool preprocess_line(std::string_view line, std::string& out) const;
     void dump_inparse();
 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../instructions/Instruction.hpp"
+
+// a file pulled in with .include, as it was read: nanoseconds of its modification time and content hash
+struct IncludedFile {
+    std::string path;
+    long modified = 0;
+    unsigned long hash = 0;
+};
+
+// what the frontend makes of a source, all the interpreter is built from
+struct Program {
+    std::vector<DecodedInstruction> instructions;
+    std::map<std::string, int> labels;
+    std::vector<int> from_in_to_inparse;
+    std::vector<int> from_inparse_to_in;
+    // the slots of the program image, encoded by the interpreter if empty
+    std::vector<uint64_t> image;
+    // the program is only valid while these are unchanged
+    std::vector<IncludedFile> includes;
+};
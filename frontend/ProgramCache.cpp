@@ -0,0 +1,251 @@
+#include "ProgramCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include "../consts.hpp"
+#include "../content_hash.hpp"
+#include "../instructions/encoding.hpp"
+#include "ModuleCache.hpp"
+
+static_assert(std::is_trivially_copyable_v<DecodedInstruction>, "records are copied as bytes");
+
+// bumped whenever the layout below changes
+static constexpr unsigned long FORMAT_VERSION = 2;
+static constexpr unsigned long MAGIC = 0x31304f5250565221UL;  // "!RVPRO01"
+
+/*  A cache file is this header followed by the records, the image slots, both
+    line maps, the labels, each label as its index, the length of its name
+    and the name, and the included files, each as its stamp, the length of its
+    path and the path. Everything is in host byte order, the file is only read
+    by the build that wrote it. */
+struct CacheHeader {
+    unsigned long magic;
+    unsigned long build;
+    unsigned long source_hash;
+    unsigned long source_size;
+    unsigned long records;
+    unsigned long in_to_inparse;
+    unsigned long inparse_to_in;
+    unsigned long labels;
+    unsigned long includes;
+    unsigned long file_size;
+};
+
+struct LabelEntry {
+    int index;
+    unsigned int length;
+};
+
+struct IncludeEntry {
+    long modified;
+    unsigned long hash;
+    unsigned long length;
+};
+
+// anything that changes what a record means makes the files of other builds a miss
+static unsigned long build_fingerprint() {
+    static const char opcodes[] =
+#define OPCODE_NAME(name) #name " "
+        OPCODE_LIST(OPCODE_NAME)
+#undef OPCODE_NAME
+        ;
+    const std::string layout = opcodes + std::to_string(sizeof(DecodedInstruction)) + " " + std::to_string(AMOUNT_REGISTERS)
+        + " " + std::to_string(INSTRUCTION_SIZE) + " " + std::to_string(FORMAT_VERSION);
+    return content_hash(layout);
+}
+
+static unsigned long lines_hash(const std::vector<std::string>& lines, unsigned long& size) {
+    unsigned long hash = content_hash("");
+    size = 0;
+    for (const std::string& line : lines) {
+        hash = content_hash("\n", content_hash(line, hash));
+        size += line.size() + 1;
+    }
+    return hash;
+}
+
+static std::string cache_path(const std::string& dir, unsigned long hash) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016lx.rvp", hash);
+    return dir + "/" + name;
+}
+
+// reads the sections of a mapped file, false as soon as one runs past its end
+class SectionReader {
+    const unsigned char* data;
+    unsigned long size;
+    unsigned long offset = sizeof(CacheHeader);
+
+   public:
+    SectionReader(const void* data_, unsigned long size_) : data(static_cast<const unsigned char*>(data_)), size(size_) {}
+
+    template <typename T>
+    bool read(std::vector<T>& out, unsigned long count) {
+        if (count > (size - offset) / sizeof(T)) {
+            return false;
+        }
+        out.resize(count);
+        std::memcpy(out.data(), data + offset, count * sizeof(T));
+        offset += count * sizeof(T);
+        return true;
+    }
+
+    bool read_label(std::map<std::string, int>& labels) {
+        LabelEntry entry;
+        if (size - offset < sizeof(entry)) {
+            return false;
+        }
+        std::memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.length > size - offset) {
+            return false;
+        }
+        labels.emplace(std::string(reinterpret_cast<const char*>(data + offset), entry.length), entry.index);
+        offset += entry.length;
+        return true;
+    }
+
+    bool read_include(std::vector<IncludedFile>& includes) {
+        IncludeEntry entry;
+        if (size - offset < sizeof(entry)) {
+            return false;
+        }
+        std::memcpy(&entry, data + offset, sizeof(entry));
+        offset += sizeof(entry);
+        if (entry.length > size - offset) {
+            return false;
+        }
+        includes.push_back({std::string(reinterpret_cast<const char*>(data + offset), entry.length), entry.modified, entry.hash});
+        offset += entry.length;
+        return true;
+    }
+
+    bool at_end() const { return offset == size; }
+};
+
+// only opcodes and registers the parser produces, a damaged file must not reach execute()
+static bool valid_records(const std::vector<DecodedInstruction>& records) {
+    for (const DecodedInstruction& record : records) {
+        if (static_cast<int>(record.opcode) > static_cast<int>(Opcode::Data)
+                || record.rd >= REGISTER_FILE_SLOTS || record.rs1 >= REGISTER_FILE_SLOTS || record.rs2 >= REGISTER_FILE_SLOTS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool load_cached_program(const std::string& dir, const std::vector<std::string>& lines, Program& program) {
+    unsigned long source_size = 0;
+    const unsigned long hash = lines_hash(lines, source_size);
+    const int fd = open(cache_path(dir, hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (unsigned long) status.st_size < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+    const unsigned long size = status.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memcpy(&header, mapping, sizeof(header));
+    Program loaded;
+    SectionReader reader(mapping, size);
+    bool hit = header.magic == MAGIC && header.build == build_fingerprint() && header.source_hash == hash
+        && header.source_size == source_size && header.file_size == size
+        && reader.read(loaded.instructions, header.records) && reader.read(loaded.image, header.records)
+        && reader.read(loaded.from_in_to_inparse, header.in_to_inparse)
+        && reader.read(loaded.from_inparse_to_in, header.inparse_to_in);
+    for (unsigned long i = 0; hit && i < header.labels; i++) {
+        hit = reader.read_label(loaded.labels);
+    }
+    for (unsigned long i = 0; hit && i < header.includes; i++) {
+        hit = reader.read_include(loaded.includes);
+    }
+    hit = hit && reader.at_end() && valid_records(loaded.instructions);
+    // the source is unchanged, the files it includes may not be
+    for (size_t i = 0; hit && i < loaded.includes.size(); i++) {
+        hit = unchanged(loaded.includes[i]);
+    }
+    munmap(mapping, size);
+    if (hit) {
+        program = std::move(loaded);
+    }
+    return hit;
+}
+
+template <typename T>
+static void append(std::string& out, const T* values, unsigned long count) {
+    out.append(reinterpret_cast<const char*>(values), count * sizeof(T));
+}
+
+bool store_cached_program(const std::string& dir, const std::vector<std::string>& lines, const Program& program) {
+    CacheHeader header = {};
+    header.magic = MAGIC;
+    header.build = build_fingerprint();
+    header.source_hash = lines_hash(lines, header.source_size);
+    header.records = program.instructions.size();
+    header.in_to_inparse = program.from_in_to_inparse.size();
+    header.inparse_to_in = program.from_inparse_to_in.size();
+    header.labels = program.labels.size();
+    header.includes = program.includes.size();
+
+    std::vector<uint64_t> image = program.image;
+    if (image.size() != program.instructions.size()) {
+        image.clear();
+        for (size_t i = 0; i < program.instructions.size(); i++) {
+            image.push_back(encode_slot(program.instructions[i], i));
+        }
+    }
+
+    std::string body;
+    append(body, program.instructions.data(), program.instructions.size());
+    append(body, image.data(), image.size());
+    append(body, program.from_in_to_inparse.data(), program.from_in_to_inparse.size());
+    append(body, program.from_inparse_to_in.data(), program.from_inparse_to_in.size());
+    for (const auto& [name, index] : program.labels) {
+        LabelEntry entry = {index, (unsigned int) name.size()};
+        append(body, &entry, 1);
+        body += name;
+    }
+    for (const IncludedFile& file : program.includes) {
+        IncludeEntry entry = {file.modified, file.hash, file.path.size()};
+        append(body, &entry, 1);
+        body += file.path;
+    }
+    header.file_size = sizeof(header) + body.size();
+
+    mkdir(dir.c_str(), 0777);
+    const std::string path = cache_path(dir, header.source_hash);
+    const std::string temporary = path + "." + std::to_string(getpid());
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out << body;
+        if (!out) {
+            std::cerr << "Can not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::cerr << "Can not write " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Program.hpp"
+
+/*  On-disk cache of parsed programs, one file per source in a directory, named
+    after the hash of the source lines. A hit maps the file and copies the
+    records, labels, line maps and image out of it without preprocessing,
+    lexing or parsing; a file of another source or of another build of the
+    emulator is a miss. Files are replaced by rename, so concurrent runs of the
+    same program never read a half-written one. */
+
+// true with program filled if dir holds the program of lines
+bool load_cached_program(const std::string& dir, const std::vector<std::string>& lines, Program& program);
+
+// writes program as the program of lines into dir, false if that fails
+bool store_cached_program(const std::string& dir, const std::vector<std::string>& lines, const Program& program);
@@ -0,0 +1,98 @@
+#include "Reassembler.hpp"
+
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "ModuleCache.hpp"
+#include "Parser.hpp"
+#include "SourceFile.hpp"
+
+
+static timespec modification_time(const std::string& file) {
+    struct stat status;
+    if (stat(file.c_str(), &status) != 0) {
+        return {};
+    }
+    return status.st_mtim;
+}
+
+Reassembler::Reassembler(std::string file_, std::string cache_dir_, std::unique_ptr<Preprocessor> preprocessor_, Program& program_, std::vector<std::string>& all_lines_)
+    : file(std::move(file_)), cache_dir(std::move(cache_dir_)), preprocessor(std::move(preprocessor_)), program(program_), all_lines(all_lines_),
+      modified_at(modification_time(file)) {}
+
+bool Reassembler::modified() const {
+    const timespec now = modification_time(file);
+    return now.tv_sec != modified_at.tv_sec || now.tv_nsec != modified_at.tv_nsec;
+}
+
+bool Reassembler::reassemble(const std::vector<DecodedInstruction>& current, Reassembly& result) {
+    modified_at = modification_time(file);
+    SourceFile source(file);
+    const std::vector<std::string_view>& lines = source.lines();
+    const bool same_lines = std::equal(lines.begin(), lines.end(), all_lines.begin(), all_lines.end());
+    const bool same_includes = std::all_of(program.includes.begin(), program.includes.end(), unchanged);
+    if (same_lines && same_includes) {
+        return false;
+    }
+
+    if (!same_includes || !reassemble_lines(lines, current, result)) {
+        reassemble_file(current, result);
+    }
+    for (size_t i = 0; i < result.instructions.size(); i++) {
+        if (i >= current.size() || result.instructions[i] != current[i]) {
+            result.changed.push_back(i);
+        }
+    }
+    result.unparsed = std::count_if(result.instructions.begin(), result.instructions.end(),
+        [](const DecodedInstruction& instruction) { return instruction.opcode == Opcode::Unparsed; });
+    all_lines.assign(lines.begin(), lines.end());
+    return true;
+}
+
+// the lines of the same file differing only in plain instruction lines, false for anything else
+bool Reassembler::reassemble_lines(const std::vector<std::string_view>& lines, const std::vector<DecodedInstruction>& current, Reassembly& result) {
+    if (preprocessor == nullptr || lines.size() != all_lines.size()) {
+        return false;
+    }
+    std::vector<std::pair<int, std::string>> edits;     // index in the program and its new line
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (lines[i] == all_lines[i]) {
+            continue;
+        }
+        std::string before, after;
+        const int index = program.from_in_to_inparse[i];
+        if (!preprocessor->preprocess_line(all_lines[i], before) || !preprocessor->preprocess_line(lines[i], after)
+                || index < 0 || program.from_inparse_to_in[index] != (int) i) {
+            return false;
+        }
+        edits.emplace_back(index, std::move(after));
+    }
+
+    result.instructions = current;
+    for (const auto& [index, line] : edits) {
+        Parser parser(Lexer(line), program.labels, program.from_inparse_to_in);
+        result.instructions[index] = parser.parse_line(index, 0);
+    }
+    result.same_layout = true;
+    result.full = false;
+    return true;
+}
+
+void Reassembler::reassemble_file(const std::vector<DecodedInstruction>& current, Reassembly& result) {
+    auto next = std::make_unique<Preprocessor>(file, cache_dir);
+    next->preprocess();
+    Parser parser(Lexer(next->get_inparse()), next->get_labels(), next->get_from_inparse_to_in());
+    result.instructions = parser.get_program();
+    result.full = true;
+
+    result.same_layout = result.instructions.size() == current.size() && next->get_labels() == program.labels;
+    for (size_t i = 0; result.same_layout && i < current.size(); i++) {
+        result.same_layout = (current[i].opcode == Opcode::Data) == (result.instructions[i].opcode == Opcode::Data);
+    }
+
+    program.labels = std::move(next->get_labels());
+    program.from_in_to_inparse = std::move(next->get_from_in_to_inparse());
+    program.from_inparse_to_in = std::move(next->get_from_inparse_to_in());
+    program.includes = next->get_included();
+    preprocessor = std::move(next);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Preprocessor.hpp"
+#include "Program.hpp"
+
+/*  Assembles a source again after it was edited, for the reload command of the
+    debugger. If every changed line is a plain instruction line before and
+    after the edit, only those lines are preprocessed and parsed again, with
+    the .eqv and macros of the last full pass. Anything else (labels, macros,
+    directives, added or removed lines, an edited included file) runs the
+    preprocessor and the parser over the whole file. Either way, the labels,
+    line maps and source lines of program are updated in place, so everything
+    holding references to them sees the new program. */
+class Reassembler {
+  public:
+    struct Reassembly {
+      std::vector<DecodedInstruction> instructions;   // the whole program after the edit
+      std::vector<size_t> changed;                    // indices of records that differ
+      // same amount of records, same labels and data in the same slots: state stays meaningful
+      bool same_layout = false;
+      // the whole file went through the frontend, records of the old text are gone
+      bool full = false;
+      // Opcode::Unparsed records left in instructions, none after a full pass
+      size_t unparsed = 0;
+    };
+
+  private:
+    std::string file;
+    std::string cache_dir;
+    // the pass program comes from, none for a program from the cache
+    std::unique_ptr<Preprocessor> preprocessor;
+    Program& program;
+    std::vector<std::string>& all_lines;
+    timespec modified_at{};
+
+    bool reassemble_lines(const std::vector<std::string_view>& lines, const std::vector<DecodedInstruction>& current, Reassembly& result);
+    void reassemble_file(const std::vector<DecodedInstruction>& current, Reassembly& result);
+
+  public:
+    Reassembler(std::string file_, std::string cache_dir_, std::unique_ptr<Preprocessor> preprocessor_, Program& program_, std::vector<std::string>& all_lines_);
+
+    // true if the file was written since the last reassemble()
+    bool modified() const;
+    // false if the source is unchanged; throws PreprocessorException or ParserException and keeps
+    // the old program if the new one does not assemble
+    bool reassemble(const std::vector<DecodedInstruction>& current, Reassembly& result);
+};
@@ -0,0 +1,42 @@
+#include "SourceFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+SourceFile::SourceFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat status;
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        void* mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            data = static_cast<const char*>(mapping);
+            size = status.st_size;
+        }
+    }
+    close(fd);
+
+    // a last line without newline still counts, an empty one after the last newline does not
+    std::string_view rest = text();
+    while (!rest.empty()) {
+        const size_t end = rest.find('\n');
+        lines_.push_back(rest.substr(0, end));
+        rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+    }
+}
+
+SourceFile::SourceFile(SourceFile&& other) noexcept : data(other.data), size(other.size), lines_(std::move(other.lines_)) {
+    other.data = nullptr;
+    other.size = 0;
+}
+
+SourceFile::~SourceFile() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
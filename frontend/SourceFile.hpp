@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/*  A source file mapped read-only once, for as long as the object lives. Its
+    lines are views into the mapping without their newline, as getline() would
+    split them; a file that can not be read has no lines. */
+class SourceFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::vector<std::string_view> lines_;
+
+  public:
+    explicit SourceFile(const std::string& path);
+    SourceFile(SourceFile&& other) noexcept;
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    std::string_view text() const { return {data, size}; }
+    const std::vector<std::string_view>& lines() const { return lines_; }
+};
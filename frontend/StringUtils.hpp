@@ -1,16 +1,20 @@
 #pragma once
 #include <cassert>
 #include <numeric>   //for accumulate
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 
 struct StringUtils {
-    static std::string concat(const std::string& sep, const std::vector<std::string>& strs) {
+    // of strings or string views
+    template <typename String>
+    static std::string concat(const std::string& sep, const std::vector<String>& strs) {
         assert(!strs.empty());
-        return std::accumulate(std::next(strs.cbegin()), strs.cend(), *strs.cbegin(),
-            [&sep](std::string c, const std::string& s)
-                { return std::move(c) + sep + s; });
+        return std::accumulate(std::next(strs.cbegin()), strs.cend(), std::string(*strs.cbegin()),
+            [&sep](std::string c, const String& s)
+                { return std::move(c.append(sep).append(s)); });
     }
 
     static std::vector<std::string> split(const std::string& s, const char del) {
@@ -24,4 +28,10 @@ struct StringUtils {
         }
         return result;
     }
-};
\ No newline at end of file
+
+    // lets unordered containers keyed by std::string be searched with a string_view
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+};
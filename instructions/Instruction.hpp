@@ -4,7 +4,100 @@
 #include <string>
 
 
+// X(name) for every opcode, in the order of enum class Opcode
+#define OPCODE_LIST(X) \
+  X(Add) X(Li) X(Addi) X(And) X(Mv) X(Or) X(SLL) X(SLLI) X(SRL) X(SRLI) X(Sub) X(Xor) \
+  X(Ecall) X(Jump) X(Call) X(JumpAndLink) \
+  X(BranchEqual) X(BranchEqualZero) X(BranchNotEqual) X(BranchLessThen) X(BranchGreaterEqual) X(BranchGreaterThen) \
+  X(Return) X(Sb) X(Sh) X(Sw) X(Lw) X(Lh) X(Lb) X(La) X(EBreak) X(Data) \
+  X(Trap) X(Stale) X(Unparsed)
+
+// X(name, first, rest) for every superinstruction: first followed by the opcode
+// (plain or fused) of the next instruction, see fusion.hpp
+#define FUSED_LIST(X) \
+  X(LiAdd, Li, Add) \
+  X(LwAddi, Lw, Addi) \
+  X(MvCall, Mv, Call) \
+  X(AddiBne, Addi, BranchNotEqual) \
+  X(AddiBlt, Addi, BranchLessThen) \
+  X(AddiAddiBne, Addi, AddiBne)
+
+enum class Opcode : unsigned char {
+#define OPCODE_ENUM(name) name,
+#define FUSED_ENUM(name, first, rest) name,
+  OPCODE_LIST(OPCODE_ENUM)
+  FUSED_LIST(FUSED_ENUM)
+#undef FUSED_ENUM
+#undef OPCODE_ENUM
+};
+
+// amount of instructions executed by one dispatch of opcode
+constexpr int fused_length(Opcode opcode) {
+  switch (opcode) {
+#define FUSED_LENGTH(name, first, rest) case Opcode::name: return 1 + fused_length(Opcode::rest);
+    FUSED_LIST(FUSED_LENGTH)
+#undef FUSED_LENGTH
+    default: return 1;
+  }
+}
+
+// the plain opcode a superinstruction starts with, opcode itself if it is plain
+constexpr Opcode leading_opcode(Opcode opcode) {
+  switch (opcode) {
+#define FUSED_LEADING(name, first, rest) case Opcode::name: return Opcode::first;
+    FUSED_LIST(FUSED_LEADING)
+#undef FUSED_LEADING
+    default: return opcode;
+  }
+}
+
+/*  Fixed-size record of a parsed instruction, executed by execute() in execute.hpp.
+    Stores keep the value register in rs2 and the base register in rs1,
+    loads and stores keep the offset in immediate, label instructions keep
+    the resolved label index in target. Opcode::Unparsed keeps the offset of
+    its line in the preprocessed program in immediate. */
+struct DecodedInstruction {
+  Opcode opcode;
+  Register rd = zero, rs1 = zero, rs2 = zero;
+  long immediate = 0;
+  long target = 0;
+
+  bool operator==(const DecodedInstruction&) const = default;
+};
+
+// destination of an ALU instruction, a result for zero goes to the sink
+constexpr Register sink_zero(Register rd) {
+  return rd == zero ? zero_sink : rd;
+}
+
+inline bool uses_pc(const DecodedInstruction& instruction) {
+  return instruction.rd == pc || instruction.rs1 == pc || instruction.rs2 == pc;
+}
+
+inline constexpr bool accesses_memory(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::Lw: case Opcode::Lh: case Opcode::Lb: case Opcode::Sw: case Opcode::Sh: case Opcode::Sb:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// instructions that may continue anywhere but at the next instruction
+inline bool is_control(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::Jump: case Opcode::Call: case Opcode::JumpAndLink: case Opcode::Return:
+    case Opcode::BranchEqual: case Opcode::BranchEqualZero: case Opcode::BranchNotEqual:
+    case Opcode::BranchLessThen: case Opcode::BranchGreaterEqual: case Opcode::BranchGreaterThen:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
 struct Instruction {
-  virtual void exec(State& state) = 0;
+  virtual DecodedInstruction decode() const = 0;
+  void exec(State& state) const;
   virtual ~Instruction() = default;
 };
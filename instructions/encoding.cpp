@@ -0,0 +1,366 @@
+#include "encoding.hpp"
+#include <utility>
+#include "../consts.hpp"
+
+
+namespace {
+
+constexpr uint32_t NOP = 0x00000013;  // addi x0, x0, 0
+
+enum MajorOpcode : uint32_t {
+  LOAD = 0x03, OP_IMM = 0x13, AUIPC = 0x17, OP_IMM_32 = 0x1B, STORE = 0x23,
+  OP = 0x33, LUI = 0x37, BRANCH = 0x63, JALR = 0x67, JAL = 0x6F, SYSTEM = 0x73
+};
+
+constexpr uint32_t ECALL = 0x00000073;
+constexpr uint32_t EBREAK = 0x00100073;
+
+// x number of every Register in ABI order, pc has none
+constexpr int NUMBER_OF[] = {
+  0, 1, 2, 3, 4, -1,
+  5, 6, 7, 28, 29, 30, 31,
+  8, 9, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27,
+  10, 11, 12, 13, 14, 15, 16, 17,
+  0,  // zero_sink is a write to x0
+};
+
+constexpr Register REGISTER_OF[] = {
+  zero, ra, sp, gp, tp, t0, t1, t2, s0, s1, a0, a1, a2, a3, a4, a5,
+  a6, a7, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, t3, t4, t5, t6,
+};
+
+bool fits(long value, int bits) {
+  return value >= -(1L << (bits - 1)) && value < (1L << (bits - 1));
+}
+
+uint32_t r_type(uint32_t funct7, int rs2, int rs1, uint32_t funct3, int rd, uint32_t opcode) {
+  return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+uint32_t i_type(long immediate, int rs1, uint32_t funct3, int rd, uint32_t opcode) {
+  return (uint32_t) (immediate & 0xFFF) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+uint32_t s_type(long immediate, int rs2, int rs1, uint32_t funct3) {
+  return (uint32_t) (immediate >> 5 & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12
+      | (uint32_t) (immediate & 0x1F) << 7 | STORE;
+}
+
+uint32_t b_type(long offset, int rs2, int rs1, uint32_t funct3) {
+  return (uint32_t) (offset >> 12 & 1) << 31 | (uint32_t) (offset >> 5 & 0x3F) << 25 | rs2 << 20 | rs1 << 15
+      | funct3 << 12 | (uint32_t) (offset >> 1 & 0xF) << 8 | (uint32_t) (offset >> 11 & 1) << 7 | BRANCH;
+}
+
+uint32_t u_type(long upper, int rd, uint32_t opcode) {
+  return (uint32_t) (upper & 0xFFFFF) << 12 | rd << 7 | opcode;
+}
+
+uint32_t j_type(long offset, int rd) {
+  return (uint32_t) (offset >> 20 & 1) << 31 | (uint32_t) (offset >> 1 & 0x3FF) << 21
+      | (uint32_t) (offset >> 11 & 1) << 20 | (uint32_t) (offset >> 12 & 0xFF) << 12 | rd << 7 | JAL;
+}
+
+// hi20 and lo12 of a 32-bit value, lo12 sign-extends when it is added back
+void split(long value, long& upper, long& lower) {
+  lower = ((value & 0xFFF) ^ 0x800) - 0x800;
+  upper = (value - lower) >> 12;
+}
+
+struct Words {
+  uint32_t first;
+  uint32_t second = NOP;
+};
+
+bool encode(const DecodedInstruction& in, long address, Words& words) {
+  const int rd = NUMBER_OF[in.rd], rs1 = NUMBER_OF[in.rs1], rs2 = NUMBER_OF[in.rs2];
+  if (rd < 0 || rs1 < 0 || rs2 < 0) {
+    return false;
+  }
+  const long immediate = in.immediate;
+  const long offset = in.target * INSTRUCTION_SIZE - address;
+  long upper, lower;
+
+  switch (in.opcode) {
+    case Opcode::Add: words.first = r_type(0x00, rs2, rs1, 0, rd, OP); return true;
+    case Opcode::Sub: words.first = r_type(0x20, rs2, rs1, 0, rd, OP); return true;
+    case Opcode::SLL: words.first = r_type(0x00, rs2, rs1, 1, rd, OP); return true;
+    case Opcode::Xor: words.first = r_type(0x00, rs2, rs1, 4, rd, OP); return true;
+    case Opcode::SRL: words.first = r_type(0x20, rs2, rs1, 5, rd, OP); return true;
+    case Opcode::Or: words.first = r_type(0x00, rs2, rs1, 6, rd, OP); return true;
+    case Opcode::And: words.first = r_type(0x00, rs2, rs1, 7, rd, OP); return true;
+    case Opcode::Mv: words.first = i_type(0, rs1, 0, rd, OP_IMM); return true;
+    case Opcode::Addi:
+      words.first = i_type(immediate, rs1, 0, rd, OP_IMM);
+      return fits(immediate, 12);
+    case Opcode::SLLI:
+      words.first = i_type(immediate, rs1, 1, rd, OP_IMM);
+      return immediate >= 0 && immediate < 64;
+    case Opcode::SRLI:
+      words.first = i_type(0x400 | immediate, rs1, 5, rd, OP_IMM);
+      return immediate >= 0 && immediate < 64;
+    case Opcode::Li:
+      if (fits(immediate, 12)) {
+        words.first = i_type(immediate, 0, 0, rd, OP_IMM);
+        return true;
+      }
+      split(immediate, upper, lower);
+      words.first = u_type(upper, rd, LUI);
+      words.second = i_type(lower, rd, 0, rd, OP_IMM_32);
+      return fits(immediate, 32);
+    case Opcode::La:
+      split(offset, upper, lower);
+      words.first = u_type(upper, rd, AUIPC);
+      words.second = i_type(lower, rd, 0, rd, OP_IMM);
+      return fits(offset, 32);
+    case Opcode::Lw: words.first = i_type(immediate, rs1, 3, rd, LOAD); return fits(immediate, 12);
+    case Opcode::Lh: words.first = i_type(immediate, rs1, 6, rd, LOAD); return fits(immediate, 12);
+    case Opcode::Lb: words.first = i_type(immediate, rs1, 4, rd, LOAD); return fits(immediate, 12);
+    case Opcode::Sw: words.first = s_type(immediate, rs2, rs1, 3); return fits(immediate, 12);
+    case Opcode::Sh: words.first = s_type(immediate, rs2, rs1, 2); return fits(immediate, 12);
+    case Opcode::Sb: words.first = s_type(immediate, rs2, rs1, 0); return fits(immediate, 12);
+    case Opcode::Ecall: words.first = ECALL; return true;
+    case Opcode::EBreak: words.first = EBREAK; return true;
+    case Opcode::Jump: words.first = j_type(offset, 0); return fits(offset, 21);
+    case Opcode::Call: words.first = j_type(offset, NUMBER_OF[ra]); return fits(offset, 21);
+    case Opcode::JumpAndLink: words.first = j_type(offset, rd); return fits(offset, 21);
+    case Opcode::Return: words.first = i_type(0, NUMBER_OF[ra], 0, 0, JALR); return true;
+    case Opcode::BranchEqual: case Opcode::BranchEqualZero: case Opcode::BranchNotEqual:
+    case Opcode::BranchLessThen: case Opcode::BranchGreaterEqual: case Opcode::BranchGreaterThen: {
+      uint32_t funct3 = in.opcode == Opcode::BranchEqual || in.opcode == Opcode::BranchEqualZero ? 0
+          : in.opcode == Opcode::BranchNotEqual ? 1
+          : in.opcode == Opcode::BranchGreaterEqual ? 5 : 4;
+      int first = rs1, second = in.opcode == Opcode::BranchEqualZero ? 0 : rs2;
+      if (in.opcode == Opcode::BranchGreaterThen) {
+        // bgt is blt with the operands swapped
+        std::swap(first, second);
+      }
+      if (fits(offset, 13)) {
+        words.first = b_type(offset, second, first, funct3);
+        return true;
+      }
+      // the inverted branch skips a jal, beq/bne and blt/bge differ in the lowest funct3 bit
+      words.first = b_type(8, second, first, funct3 ^ 1);
+      words.second = j_type(offset - 4, 0);
+      return fits(offset - 4, 21);
+    }
+    default:
+      // data is no instruction, traps and superinstructions only exist in the decode cache
+      return false;
+  }
+}
+
+long i_immediate(uint32_t word) { return (int32_t) word >> 20; }
+long s_immediate(uint32_t word) { return (long) ((int32_t) word >> 25) << 5 | (word >> 7 & 0x1F); }
+long u_immediate(uint32_t word) { return (int32_t) (word & 0xFFFFF000); }
+
+long b_immediate(uint32_t word) {
+  return (long) ((int32_t) word >> 31) << 12 | (word >> 7 & 1) << 11 | (word >> 25 & 0x3F) << 5 | (word >> 8 & 0xF) << 1;
+}
+
+long j_immediate(uint32_t word) {
+  return (long) ((int32_t) word >> 31) << 20 | (word >> 12 & 0xFF) << 12 | (word >> 20 & 1) << 11 | (word >> 21 & 0x3FF) << 1;
+}
+
+// label instructions need a target on a slot, or on a word of a stream with a stride of 4
+bool set_target(DecodedInstruction& in, long destination, long stride) {
+  in.target = destination / stride;
+  return destination >= 0 && destination % stride == 0;
+}
+
+bool decode_branch(uint32_t word, uint32_t funct3, long destination, long stride, DecodedInstruction& in) {
+  const Register rs1 = REGISTER_OF[word >> 15 & 31], rs2 = REGISTER_OF[word >> 20 & 31];
+  in.rs1 = rs1;
+  in.rs2 = rs2;
+  switch (funct3) {
+    case 0: in.opcode = rs2 == zero ? Opcode::BranchEqualZero : Opcode::BranchEqual; break;
+    case 1: in.opcode = Opcode::BranchNotEqual; break;
+    case 4: in.opcode = Opcode::BranchLessThen; break;
+    case 5: in.opcode = Opcode::BranchGreaterEqual; break;
+    default: return false;
+  }
+  if (in.opcode == Opcode::BranchEqualZero) {
+    in.rs2 = zero;
+  }
+  return set_target(in, destination, stride);
+}
+
+bool decode_pair(uint32_t first, uint32_t second, long address, long stride, DecodedInstruction& in) {
+  const uint32_t rd = first >> 7 & 31;
+  // the second word has to complete the first one on the same register
+  const bool chained = (second >> 7 & 31) == rd && (second >> 15 & 31) == rd && (second >> 12 & 7) == 0;
+  switch (first & 0x7F) {
+    case LUI:
+      if (!chained || (second & 0x7F) != OP_IMM_32) {
+        return false;
+      }
+      in.opcode = Opcode::Li;
+      in.rd = sink_zero(REGISTER_OF[rd]);
+      in.immediate = (int32_t) (u_immediate(first) + i_immediate(second));
+      return true;
+    case AUIPC: {
+      // call as other assemblers write it, the link overwrites what auipc left in the register
+      if (chained && (second & 0x7F) == JALR) {
+        in.opcode = rd == 0 ? Opcode::Jump : REGISTER_OF[rd] == ra ? Opcode::Call : Opcode::JumpAndLink;
+        in.rd = in.opcode == Opcode::JumpAndLink ? REGISTER_OF[rd] : zero;
+        return set_target(in, address + u_immediate(first) + i_immediate(second), stride);
+      }
+      if (!chained || (second & 0x7F) != OP_IMM) {
+        return false;
+      }
+      const long value = address + u_immediate(first) + i_immediate(second);
+      in.rd = REGISTER_OF[rd];
+      if (value >= 0 && value % stride == 0) {
+        in.opcode = Opcode::La;
+        in.target = value / stride;
+      } else {
+        in.opcode = Opcode::Li;
+        in.rd = sink_zero(in.rd);
+        in.immediate = value;
+      }
+      return true;
+    }
+    case BRANCH:
+      // a far branch: the inverted condition jumps over a jal
+      if (b_immediate(first) != 8 || (second & 0xFFF) != JAL) {
+        return false;
+      }
+      return decode_branch(first, (first >> 12 & 7) ^ 1, address + 4 + j_immediate(second), stride, in);
+    default:
+      return false;
+  }
+}
+
+bool decode(uint32_t word, uint32_t second, long address, long stride, DecodedInstruction& in) {
+  if (second != NOP) {
+    return decode_pair(word, second, address, stride, in);
+  }
+  const Register rd = REGISTER_OF[word >> 7 & 31], rs1 = REGISTER_OF[word >> 15 & 31], rs2 = REGISTER_OF[word >> 20 & 31];
+  const uint32_t funct3 = word >> 12 & 7, funct7 = word >> 25;
+  in.rs1 = rs1;
+  in.rs2 = rs2;
+
+  switch (word & 0x7F) {
+    case OP:
+      in.rd = sink_zero(rd);
+      switch (funct7 << 3 | funct3) {
+        case 0x000: in.opcode = Opcode::Add; return true;
+        case 0x100: in.opcode = Opcode::Sub; return true;
+        case 0x001: in.opcode = Opcode::SLL; return true;
+        case 0x004: in.opcode = Opcode::Xor; return true;
+        case 0x105: in.opcode = Opcode::SRL; return true;
+        case 0x006: in.opcode = Opcode::Or; return true;
+        case 0x007: in.opcode = Opcode::And; return true;
+        default: return false;
+      }
+    case OP_IMM:
+      in.rd = sink_zero(rd);
+      in.rs2 = zero;
+      in.immediate = i_immediate(word);
+      if (funct3 == 0) {
+        in.opcode = rs1 == zero ? Opcode::Li : in.immediate == 0 ? Opcode::Mv : Opcode::Addi;
+        in.rs1 = in.opcode == Opcode::Li ? zero : rs1;
+        return true;
+      }
+      // 6-bit shift amounts, srai has bit 10 of the immediate set
+      in.immediate = word >> 20 & 63;
+      if (funct3 == 1 && funct7 >> 1 == 0x00) {
+        in.opcode = Opcode::SLLI;
+        return true;
+      }
+      if (funct3 == 5 && funct7 >> 1 == 0x10) {
+        in.opcode = Opcode::SRLI;
+        return true;
+      }
+      return false;
+    case LOAD:
+      in.rd = rd;
+      in.rs2 = zero;
+      in.immediate = i_immediate(word);
+      in.opcode = funct3 == 3 ? Opcode::Lw : funct3 == 6 ? Opcode::Lh : Opcode::Lb;
+      return funct3 == 3 || funct3 == 6 || funct3 == 4;
+    case STORE:
+      in.immediate = s_immediate(word);
+      in.opcode = funct3 == 3 ? Opcode::Sw : funct3 == 2 ? Opcode::Sh : Opcode::Sb;
+      return funct3 == 3 || funct3 == 2 || funct3 == 0;
+    case LUI:
+      in.opcode = Opcode::Li;
+      in.rd = sink_zero(rd);
+      in.rs1 = in.rs2 = zero;
+      in.immediate = u_immediate(word);
+      return true;
+    case BRANCH:
+      return decode_branch(word, funct3, address + b_immediate(word), stride, in);
+    case JAL:
+      in.rs1 = in.rs2 = zero;
+      in.rd = rd;
+      in.opcode = rd == zero ? Opcode::Jump : rd == ra ? Opcode::Call : Opcode::JumpAndLink;
+      if (in.opcode != Opcode::JumpAndLink) {
+        in.rd = zero;
+      }
+      return set_target(in, address + j_immediate(word), stride);
+    case JALR:
+      in = DecodedInstruction{Opcode::Return};
+      return word == i_type(0, NUMBER_OF[ra], 0, 0, JALR);
+    case SYSTEM:
+      in = DecodedInstruction{word == EBREAK ? Opcode::EBreak : Opcode::Ecall};
+      return word == ECALL || word == EBREAK;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+uint64_t encode_slot(const DecodedInstruction& instruction, size_t index) {
+  if (instruction.opcode == Opcode::Data) {
+    return (uint64_t) instruction.immediate;
+  }
+  Words words;
+  if (!encode(instruction, (long) (index * INSTRUCTION_SIZE), words)) {
+    return NO_ENCODING;
+  }
+  return words.first | (uint64_t) words.second << 32;
+}
+
+DecodedInstruction decode_slot(uint64_t slot, size_t index) {
+  DecodedInstruction instruction{Opcode::Data};
+  if (!decode((uint32_t) slot, (uint32_t) (slot >> 32), (long) (index * INSTRUCTION_SIZE), INSTRUCTION_SIZE, instruction)) {
+    instruction = DecodedInstruction{Opcode::Data};
+    instruction.immediate = (long) slot;
+  }
+  return instruction;
+}
+
+uint64_t encode_constant_load(Register rd, size_t index, size_t pool_index) {
+  const int number = NUMBER_OF[rd];
+  const long offset = ((long) pool_index - (long) index) * INSTRUCTION_SIZE;
+  long upper, lower;
+  split(offset, upper, lower);
+  if (number < 0 || !fits(offset, 32)) {
+    return NO_ENCODING;
+  }
+  return u_type(upper, number, AUIPC) | (uint64_t) i_type(lower, number, 3, number, LOAD) << 32;
+}
+
+bool decode_constant_load(uint64_t slot, size_t index, Register& rd, size_t& pool_index) {
+  const uint32_t first = (uint32_t) slot, second = (uint32_t) (slot >> 32);
+  const uint32_t number = first >> 7 & 31;
+  const long address = (long) (index * INSTRUCTION_SIZE) + u_immediate(first) + i_immediate(second);
+  if ((first & 0x7F) != AUIPC || (second & 0x707F) != (3 << 12 | LOAD) || (second >> 7 & 31) != number
+      || (second >> 15 & 31) != number || address < 0 || address % INSTRUCTION_SIZE != 0) {
+    return false;
+  }
+  rd = sink_zero(REGISTER_OF[number]);
+  pool_index = address / INSTRUCTION_SIZE;
+  return true;
+}
+
+DecodedInstruction decode_stream(uint32_t first, uint32_t second, long address, bool& pair) {
+  DecodedInstruction instruction{Opcode::Data};
+  pair = second != NOP && decode(first, second, address, STREAM_STRIDE, instruction);
+  if (!pair && !decode(first, NOP, address, STREAM_STRIDE, instruction)) {
+    instruction = DecodedInstruction{Opcode::Data};
+    instruction.immediate = first;
+  }
+  return instruction;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "Instruction.hpp"
+
+/*  Machine code of the program image. Every instruction has a slot of
+    INSTRUCTION_SIZE bytes in guest memory holding its RV64IM encoding: one
+    32-bit word followed by a nop, or two words for what an assembler expands
+    into a pair (li of a 32-bit constant as lui + addiw, la as auipc + addi, a
+    branch out of the 13-bit range as the inverted branch over a jal).
+    Opcodes keep their meaning in this emulator: sw/sh/sb store 8/4/1 bytes and
+    are encoded as sd/sw/sb, lw/lh/lb load zero-extended as ld/lwu/lbu, srl and
+    srli shift arithmetically as sra/srai, call and jal leave the address of
+    the call in the link register.
+    An instruction without an encoding (an operand of pc, an immediate out of
+    range) gets NO_ENCODING in memory and is only known to the decode cache.
+    Decoding knows the encodings of these opcodes and nothing else of RV64IM:
+    add sub sll xor or and sra, addi slli srai, ld lwu lbu, sd sw sb, lui,
+    the pairs above and auipc + jalr, beq bne blt bge, jal, jalr zero, 0(ra),
+    ecall and ebreak. The M extension, the W forms, srl and srli, slt, the
+    logic immediates, unsigned branches, the other loads and stores, any
+    other jalr, fences, csr and compressed instructions decode to Opcode::Data. */
+
+constexpr uint64_t NO_ENCODING = 0;
+
+// the slot of instruction at index, data is its own value
+uint64_t encode_slot(const DecodedInstruction& instruction, size_t index);
+
+// the instruction of a slot at index, Opcode::Data for anything without a meaning here
+DecodedInstruction decode_slot(uint64_t slot, size_t index);
+
+/*  li of a constant beyond 32 bits does not fit into a slot as lui + addiw.
+    The emitter keeps such a constant in a slot of its own at pool_index and
+    loads it with auipc + ld, NO_ENCODING for rd = pc. */
+uint64_t encode_constant_load(Register rd, size_t index, size_t pool_index);
+
+// true if slot at index is such a load, with its register and the slot of its constant
+bool decode_constant_load(uint64_t slot, size_t index, Register& rd, size_t& pool_index);
+
+// the bytes per instruction of a plain RV64 instruction stream
+constexpr long STREAM_STRIDE = 4;
+
+/*  The instruction at address of a plain instruction stream, as another
+    toolchain writes it: pair is set if second completes first, the way
+    decode_slot() reads the two words of a slot. Targets are word numbers
+    (address / STREAM_STRIDE) for the caller to map to slots. */
+DecodedInstruction decode_stream(uint32_t first, uint32_t second, long address, bool& pair);
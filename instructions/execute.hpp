@@ -0,0 +1,199 @@
+#pragma once
+#include "Instruction.hpp"
+#include "../consts.hpp"
+
+/*  Semantics of every opcode over a DecodedInstruction.
+    Control instructions set pc to the address before their target,
+    the caller advances pc by INSTRUCTION_SIZE after every instruction.
+    A superinstruction executes its record and the records following it in
+    the same array, which keep their own operands: it only runs through
+    execute_fused(), which takes a pointer into that array. */
+
+void ecall(State& state);
+[[noreturn]] void data_executed();
+// a superinstruction handed to execute() without the records after it
+[[noreturn]] void fused_executed_alone();
+// marks the decode cache records overwritten by width bytes at address stale
+[[gnu::cold]] void code_written(State& state, long address, unsigned long width);
+
+// a store that may overwrite code, one compare when it does not
+template <typename T>
+[[gnu::always_inline]] inline void store_checked(State& state, long address, T value) {
+  state.memory.store<T>(address, value);
+  if (state.code.overlaps(address, sizeof(T))) [[unlikely]] {
+    code_written(state, address, sizeof(T));
+  }
+}
+
+// semantics of a single opcode, the switch folds away for a constant opcode
+template <Opcode opcode>
+[[gnu::always_inline]] inline void execute(const DecodedInstruction& instruction, State& state) {
+  static_assert(fused_length(opcode) == 1, "a superinstruction runs through execute_fused()");
+  long* registers = state.registers.data();
+  Memory& memory = state.memory;
+  const Register rd = instruction.rd;
+  const Register rs1 = instruction.rs1;
+  const Register rs2 = instruction.rs2;
+  const long immediate = instruction.immediate;
+
+  switch (opcode) {
+    case Opcode::Add:
+      registers[rd] = registers[rs1] + registers[rs2];
+      break;
+    case Opcode::Li:
+      registers[rd] = immediate;
+      break;
+    case Opcode::Addi:
+      registers[rd] = registers[rs1] + immediate;
+      break;
+    case Opcode::And:
+      registers[rd] = registers[rs1] & registers[rs2];
+      break;
+    case Opcode::Mv:
+      registers[rd] = registers[rs1];
+      break;
+    case Opcode::Or:
+      registers[rd] = registers[rs1] | registers[rs2];
+      break;
+    case Opcode::SLL:
+      // logical left shift of rs1 by the low bits of rs2
+      registers[rd] = registers[rs1] << (registers[rs2] & ((1 << 7) - 1));
+      break;
+    case Opcode::SLLI:
+      registers[rd] = registers[rs1] << (immediate & ((1 << 7) - 1));
+      break;
+    case Opcode::SRL:
+      // logical right shift of rs1 by the low bits of rs2
+      registers[rd] = registers[rs1] >> (registers[rs2] & ((1 << 7) - 1));
+      break;
+    case Opcode::SRLI:
+      registers[rd] = registers[rs1] >> (immediate & ((1 << 7) - 1));
+      break;
+    case Opcode::Sub:
+      registers[rd] = registers[rs1] - registers[rs2];
+      break;
+    case Opcode::Xor:
+      registers[rd] = registers[rs1] ^ registers[rs2];
+      break;
+    case Opcode::Ecall:
+      ecall(state);
+      break;
+    case Opcode::Jump:
+      registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE;
+      break;
+    case Opcode::Call:
+      registers[ra] = registers[pc];
+      registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE;
+      break;
+    case Opcode::JumpAndLink:
+      registers[rd] = registers[pc];
+      registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE;
+      break;
+    case Opcode::BranchEqual:
+      if (registers[rs1] == registers[rs2]) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::BranchEqualZero:
+      if (registers[rs1] == 0) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::BranchNotEqual:
+      if (registers[rs1] != registers[rs2]) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::BranchLessThen:
+      if (registers[rs1] < registers[rs2]) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::BranchGreaterEqual:
+      if (registers[rs1] >= registers[rs2]) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::BranchGreaterThen:
+      if (registers[rs1] > registers[rs2]) { registers[pc] = (instruction.target - 1) * INSTRUCTION_SIZE; }
+      break;
+    case Opcode::Return:
+      registers[pc] = registers[ra];
+      break;
+    case Opcode::Sb:
+      // store 8-bit value from the low bits of rs2
+      store_checked<uint8_t>(state, registers[rs1] + immediate, (uint8_t) registers[rs2]);
+      break;
+    case Opcode::Sh:
+      // store 32-bit value from the low bits of rs2
+      store_checked<uint32_t>(state, registers[rs1] + immediate, (uint32_t) registers[rs2]);
+      break;
+    case Opcode::Sw:
+      // store 64-bit value of rs2
+      store_checked<uint64_t>(state, registers[rs1] + immediate, (uint64_t) registers[rs2]);
+      break;
+    // loads zero-extend
+    case Opcode::Lw:
+      registers[rd] = memory.load_extended<uint64_t>(registers[rs1] + immediate);
+      break;
+    case Opcode::Lh:
+      registers[rd] = memory.load_extended<uint32_t>(registers[rs1] + immediate);
+      break;
+    case Opcode::Lb:
+      registers[rd] = memory.load_extended<uint8_t>(registers[rs1] + immediate);
+      break;
+    case Opcode::La:
+      registers[rd] = instruction.target * INSTRUCTION_SIZE;
+      break;
+    case Opcode::EBreak:
+      break;
+    case Opcode::Data:
+      data_executed();
+    case Opcode::Trap:
+      // breakpoint patched in by the debugger, its loop stops before executing it
+      break;
+    case Opcode::Stale:
+      // overwritten code, the engines re-decode or hand over before executing it
+      break;
+    case Opcode::Unparsed:
+      // a line not parsed yet, the switch loop parses it before executing it
+      break;
+    default:
+      // superinstructions, ruled out above
+      break;
+  }
+}
+
+// the record at instruction, and for a superinstruction the records after it
+template <Opcode opcode>
+[[gnu::always_inline]] inline void execute_fused(const DecodedInstruction* instruction, State& state) {
+  switch (opcode) {
+#define FUSED_CASE(name, first, rest)                               \
+    case Opcode::name:                                              \
+      execute<Opcode::first>(instruction[0], state);                \
+      state.registers[pc] += INSTRUCTION_SIZE;                      \
+      execute_fused<Opcode::rest>(instruction + 1, state);          \
+      break;
+    FUSED_LIST(FUSED_CASE)
+#undef FUSED_CASE
+    default:
+      if constexpr (fused_length(opcode) == 1) {
+        execute<opcode>(*instruction, state);
+      }
+      break;
+  }
+}
+
+// always inlined so the interpreter loop dispatches through a single jump table
+[[gnu::always_inline]] inline void execute(const DecodedInstruction& instruction, State& state) {
+  switch (instruction.opcode) {
+#define OPCODE_CASE(name) case Opcode::name: execute<Opcode::name>(instruction, state); break;
+#define FUSED_CASE(name, first, rest) case Opcode::name: fused_executed_alone();
+    OPCODE_LIST(OPCODE_CASE)
+    FUSED_LIST(FUSED_CASE)
+#undef FUSED_CASE
+#undef OPCODE_CASE
+  }
+}
+
+// instruction points into the decode cache or a copy of it that holds the records after it
+[[gnu::always_inline]] inline void execute_fused(const DecodedInstruction* instruction, State& state) {
+  switch (instruction->opcode) {
+#define OPCODE_CASE(name) case Opcode::name: execute_fused<Opcode::name>(instruction, state); break;
+#define FUSED_CASE(name, first, rest) OPCODE_CASE(name)
+    OPCODE_LIST(OPCODE_CASE)
+    FUSED_LIST(FUSED_CASE)
+#undef FUSED_CASE
+#undef OPCODE_CASE
+  }
+}
@@ -0,0 +1,28 @@
+#include "fusion.hpp"
+
+
+// instructions touching the pc register are never fused, they may change the control flow
+static bool matches(const std::vector<DecodedInstruction>& program, size_t index, Opcode opcode) {
+  if (index >= program.size() || uses_pc(program[index])) {
+    return false;
+  }
+  switch (opcode) {
+#define FUSED_MATCH(name, first, rest) \
+    case Opcode::name: return program[index].opcode == Opcode::first && matches(program, index + 1, Opcode::rest);
+    FUSED_LIST(FUSED_MATCH)
+#undef FUSED_MATCH
+    default:
+      return program[index].opcode == opcode;
+  }
+}
+
+Opcode fuse_at(const std::vector<DecodedInstruction>& program, size_t index) {
+  Opcode fused = program[index].opcode;
+#define FUSED_TRY(name, first, rest) \
+  if (fused_length(Opcode::name) > fused_length(fused) && matches(program, index, Opcode::name)) { \
+    fused = Opcode::name; \
+  }
+  FUSED_LIST(FUSED_TRY)
+#undef FUSED_TRY
+  return fused;
+}
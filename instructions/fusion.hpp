@@ -0,0 +1,19 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include "Instruction.hpp"
+
+/*  Superinstruction fusion over a decoded program (FUSED_LIST in Instruction.hpp).
+    Only the opcode of the first instruction is replaced, the following records stay
+    as they are, so jumps into the middle of a superinstruction, from_inparse_to_in
+    and breakpoints keep working with the same indices. */
+
+constexpr int MAX_FUSED_LENGTH = std::max({
+#define FUSED_LENGTH_OF(name, first, rest) fused_length(Opcode::name),
+  FUSED_LIST(FUSED_LENGTH_OF)
+#undef FUSED_LENGTH_OF
+  1
+});
+
+// opcode of the longest superinstruction starting at index, or the opcode at index
+Opcode fuse_at(const std::vector<DecodedInstruction>& program, size_t index);
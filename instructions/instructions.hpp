@@ -9,11 +9,18 @@
 #include "../consts.hpp"
 
 using namespace std;
+
+struct LabelInstruction : Instruction {
+  // label operand and its instruction index, bound by Parser::get_instructions()
+  std::string label;
+  int target = 0;
+};
+
 struct Add : Instruction {
   Register dist, source1, source2;
 
   Add(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Li : Instruction {
@@ -21,7 +28,7 @@ struct Li : Instruction {
   long immediate;
 
   Li(vector<std::string> args);
-  void exec(State& state);
+  DecodedInstruction decode() const;
 };
 
 struct Addi : Instruction {
@@ -29,157 +36,138 @@ struct Addi : Instruction {
   long immediate;
 
   Addi(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct And : Instruction {
   Register dist, source1, source2;
 
   And(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Mv : Instruction {
   Register dist, source;
 
   Mv(vector<std::string> args);
-  void exec(State& state);
+  DecodedInstruction decode() const;
 };
 
 struct Or : Instruction {
   Register dist, source1, source2;
 
   Or(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct SLL : Instruction {
   Register dist, source1, source2;
 
   SLL(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 struct SLLI : Instruction {
   Register dist, source;
   long immediate;
 
   SLLI(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 struct SRL : Instruction {
   Register dist, source1, source2;
 
   SRL(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 struct SRLI : Instruction {
   Register dist, source;
   long immediate;
 
   SRLI(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Sub : Instruction {
   Register dist, source1, source2;
 
   Sub(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Xor : Instruction {
   Register dist, source1, source2;
 
   Xor(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Ecall : Instruction {
-  map<int, function<void(State&)>> functions = {
-    {PRINT_INT, [](State& state) { std::cout << state.registers[a0]; }},
-    {READ_INT, [](State& state) { scanf("%ld", &state.registers[a0]); }},
-    {EXIT_0, [](State& state){ exit(0); }},
-    {EXIT, [](State& state) { exit(state.registers[a0]); }},
-    {PRINT_CHAR, [](State& state) { std::cout << static_cast<char>(state.registers[a0]); }},
-    {READ_CHAR, [](State& state) { char c;
-                                  scanf("%c", &c); 
-                                  state.registers[a0] = (long) c; }}
-  };
   Ecall(std::vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct Jump : Instruction {
-  std::string label;
+struct Jump : LabelInstruction {
   Jump(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct Call : Instruction {
-  std::string label;
+struct Call : LabelInstruction {
   Call(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct JumpAndLink : Instruction {
+struct JumpAndLink : LabelInstruction {
   Register return_register;
-  std::string label;
 
   JumpAndLink(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchEqual: Instruction {
+struct BranchEqual : LabelInstruction {
   Register first, second;
-  std::string label;
 
   BranchEqual(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchEqualZero : Instruction {
+struct BranchEqualZero : LabelInstruction {
   Register first;
-  std::string label;
 
   BranchEqualZero(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchNotEqual: Instruction {
+struct BranchNotEqual : LabelInstruction {
   Register first, second;
-  std::string label;
 
   BranchNotEqual(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchLessThen: Instruction {
+struct BranchLessThen : LabelInstruction {
   Register first, second;
-  std::string label;
 
   BranchLessThen(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchGreaterEqual: Instruction {
+struct BranchGreaterEqual : LabelInstruction {
   Register first, second;
-  std::string label;
 
   BranchGreaterEqual(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct BranchGreaterThen: Instruction {
+struct BranchGreaterThen : LabelInstruction {
   Register first, second;
-  std::string label;
 
   BranchGreaterThen(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Return: Instruction {
   Return(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 
@@ -188,7 +176,7 @@ struct Sb : Instruction {
   int offset;
 
   Sb(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Sh : Instruction {
@@ -196,7 +184,7 @@ struct Sh : Instruction {
   int offset;
 
   Sh(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Sw : Instruction {
@@ -204,7 +192,7 @@ struct Sw : Instruction {
   int offset;
 
   Sw(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Lw : Instruction {
@@ -212,7 +200,7 @@ struct Lw : Instruction {
   int offset;
 
   Lw(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Lh : Instruction {
@@ -220,7 +208,7 @@ struct Lh : Instruction {
   int offset;
 
   Lh(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Lb : Instruction {
@@ -228,27 +216,26 @@ struct Lb : Instruction {
   int offset;
 
   Lb(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
-struct La : Instruction {
+struct La : LabelInstruction {
   // Load label address to register (dst) 
   Register dst;
-  std::string label;
 
   La(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct EBreak : Instruction {
   EBreak(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
 struct Data : Instruction {
   long content;
 
   Data(vector<std::string> args);
-  void exec(State &state);
+  DecodedInstruction decode() const;
 };
 
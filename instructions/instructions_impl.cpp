@@ -1,6 +1,9 @@
 #include "../frontend/Parser.hpp"
+#include "../exceptions/ExitException.hpp"
 #include "../exceptions/RuntimeException.hpp"
 #include "instructions.hpp"
+#include "execute.hpp"
+#include "fusion.hpp"
 #include "../consts.hpp"
 #include "cassert"
 #include <string>
@@ -11,6 +14,55 @@
 /*  Constructors check arguments and can throw ParserException.
     In this case, the fields have not yet been validated and a destructor is not needed. */
 
+/*  decode() packs the validated fields into a DecodedInstruction,
+    the semantics of every instruction live in execute() (execute.hpp). */
+
+
+void Instruction::exec(State& state) const {
+  execute(decode(), state);
+}
+
+void ecall(State& state) {
+  switch (state.registers[a7]) {
+    case PRINT_INT: std::cout << state.registers[a0]; break;
+    case READ_INT: scanf("%ld", &state.registers[a0]); break;
+    // unwinds the engine, so the run is counted and --stats still prints
+    case EXIT_0: throw ExitException(0);
+    case EXIT: throw ExitException(state.registers[a0]);
+    case PRINT_CHAR: std::cout << static_cast<char>(state.registers[a0]); break;
+    case READ_CHAR: {
+      char c;
+      scanf("%c", &c);
+      state.registers[a0] = (long) c;
+      break;
+    }
+    default:
+      throw EcallException("Wrong index of ecall " + std::to_string(state.registers[a7]));
+  }
+}
+
+void data_executed() {
+  throw RuntimeException("DATA SECTION CANNOT BE EXECUTED");
+}
+
+void fused_executed_alone() {
+  throw RuntimeException("SUPERINSTRUCTION EXECUTED WITHOUT ITS INSTRUCTIONS");
+}
+
+void code_written(State& state, long address, unsigned long width) {
+  const long start = state.code.start, end = start + (long) state.code.size;
+  const long first = std::max(address, start) / INSTRUCTION_SIZE;
+  const long last = (std::min(address + (long) width, end) - 1) / INSTRUCTION_SIZE;
+  // a superinstruction starting before first runs the records it covers from its own handler
+  for (long i = std::max(first - (MAX_FUSED_LENGTH - 1), start / INSTRUCTION_SIZE); i <= last; i++) {
+    DecodedInstruction& record = state.decoded[i];
+    if (i >= first || i + fused_length(record.opcode) > first) {
+      record.opcode = Opcode::Stale;
+    }
+  }
+  state.code_written = true;
+}
+
 
 Add::Add(vector<string> args) {
   // converted to types: Register, Register, Register
@@ -27,11 +79,8 @@ Add::Add(vector<string> args) {
   source2 = source2_;
 }
 
-void Add::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1] + state.registers[source2];
+DecodedInstruction Add::decode() const {
+  return {Opcode::Add, sink_zero(dist), source1, source2};
 }
 
 
@@ -43,9 +92,7 @@ Li::Li(vector<string> args) {
   }
   Register dist_ = Parser::get_register(args[0]);
   long immediate_;
-  if (Parser::is_number(args[1])) {
-      immediate_ = Parser::get_immediate(args[1]);
-  } else {
+  if (!Parser::parse_immediate(args[1], immediate_)) {
     throw ParserException("invalid immediate in li: " + args[1]);
   }
 
@@ -53,11 +100,8 @@ Li::Li(vector<string> args) {
   immediate = immediate_;
 }
 
-void Li::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = immediate;
+DecodedInstruction Li::decode() const {
+  return {Opcode::Li, sink_zero(dist), zero, zero, immediate};
 }
 
 
@@ -70,9 +114,7 @@ Addi::Addi(vector<string> args) {
   Register dist_ = Parser::get_register(args[0]);
   Register source_ = Parser::get_register(args[1]);
   long immediate_;
-  if (Parser::is_number(args[2])) {
-      immediate_ = Parser::get_immediate(args[2]);
-  } else {
+  if (!Parser::parse_immediate(args[2], immediate_)) {
     throw ParserException("invalid immediate in addi: " + args[2]);
   }
 
@@ -81,11 +123,8 @@ Addi::Addi(vector<string> args) {
   immediate = immediate_;
 }
 
-void Addi::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source] + immediate;
+DecodedInstruction Addi::decode() const {
+  return {Opcode::Addi, sink_zero(dist), source, zero, immediate};
 }
 
 
@@ -104,11 +143,8 @@ And::And(vector<string> args) {
   source2 = source2_;
 }
 
-void And::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1] & state.registers[source2];
+DecodedInstruction And::decode() const {
+  return {Opcode::And, sink_zero(dist), source1, source2};
 }
 
 
@@ -125,11 +161,8 @@ Mv::Mv(vector<string> args) {
   source = source_;
 }
 
-void Mv::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source];
+DecodedInstruction Mv::decode() const {
+  return {Opcode::Mv, sink_zero(dist), source};
 }
 
 
@@ -148,11 +181,8 @@ Or::Or(vector<string> args) {
   source2 = source2_;
 }
 
-void Or::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1] | state.registers[source2];
+DecodedInstruction Or::decode() const {
+  return {Opcode::Or, sink_zero(dist), source1, source2};
 }
 
 
@@ -171,14 +201,8 @@ SLL::SLL(vector<string> args) {
   source2 = source2_;
 }
 
-void SLL::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1]
-                          << (state.registers[source2] & ((1 << 7) - 1));
-  // Performs logical left shift on the value in register rs1 by the shift
-  // amount held in the lower 5 bits of register rs2.
+DecodedInstruction SLL::decode() const {
+  return {Opcode::SLL, sink_zero(dist), source1, source2};
 }
 
 SLLI::SLLI(vector<string> args) {
@@ -197,11 +221,8 @@ SLLI::SLLI(vector<string> args) {
 
 }
 
-void SLLI::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = (state.registers[source] << (immediate & ((1 << 7) - 1)));
+DecodedInstruction SLLI::decode() const {
+  return {Opcode::SLLI, sink_zero(dist), source, zero, immediate};
 }
 
 
@@ -220,14 +241,8 @@ SRL::SRL(vector<string> args) {
   source2 = source2_;
 }
 
-void SRL::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] =
-      state.registers[source1] >> (state.registers[source2] & ((1 << 7) - 1));
-  // Description: Logical right shift on the value in register rs1 by the shift
-  // amount held in the lower 5 bits of register rs2
+DecodedInstruction SRL::decode() const {
+  return {Opcode::SRL, sink_zero(dist), source1, source2};
 }
 
 SRLI::SRLI(vector<string> args) {
@@ -246,11 +261,8 @@ SRLI::SRLI(vector<string> args) {
 
 }
 
-void SRLI::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source] >> (immediate & ((1 << 7) - 1));
+DecodedInstruction SRLI::decode() const {
+  return {Opcode::SRLI, sink_zero(dist), source, zero, immediate};
 }
 
 
@@ -269,11 +281,8 @@ Sub::Sub(vector<string> args) {
   source2 = source2_;
 }
 
-void Sub::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1] - state.registers[source2];
+DecodedInstruction Sub::decode() const {
+  return {Opcode::Sub, sink_zero(dist), source1, source2};
 }
 
 
@@ -292,18 +301,12 @@ Xor::Xor(vector<string> args) {
   source2 = source2_;
 }
 
-void Xor::exec(State &state) {
-  if (dist == zero) {
-    return;
-  }
-  state.registers[dist] = state.registers[source1] ^ state.registers[source2];
+DecodedInstruction Xor::decode() const {
+  return {Opcode::Xor, sink_zero(dist), source1, source2};
 }
 
-void Ecall::exec(State &state) { 
-  if (functions.count(state.registers[a7]) == 0) {
-    throw EcallException("Wrong index of ecall " + std::to_string(state.registers[a7]));
-  }
-  functions[state.registers[a7]](state);
+DecodedInstruction Ecall::decode() const {
+  return {Opcode::Ecall};
 }
 
 Ecall::Ecall(vector<string> args) {
@@ -322,13 +325,14 @@ Call::Call(vector<std::string> args) {
   label = args[0];
 }
 
-void Call::exec(State &state) { 
-  state.registers[ra] = state.registers[pc];
-  state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
+DecodedInstruction Call::decode() const {
+  return {Opcode::Call, zero, zero, zero, 0, target};
 }
 
 
-void Jump::exec(State &state) { state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE; }
+DecodedInstruction Jump::decode() const {
+  return {Opcode::Jump, zero, zero, zero, 0, target};
+}
 
 Jump::Jump(vector<string> args) {
   int args_amount = 1;
@@ -338,9 +342,8 @@ Jump::Jump(vector<string> args) {
   label = args[0];
 }
 
-void JumpAndLink::exec(State &state) {
-  state.registers[return_register] = state.registers[pc];
-  state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
+DecodedInstruction JumpAndLink::decode() const {
+  return {Opcode::JumpAndLink, return_register, zero, zero, 0, target};
 }
  
 JumpAndLink::JumpAndLink(vector<string> args) {
@@ -354,10 +357,8 @@ JumpAndLink::JumpAndLink(vector<string> args) {
   return_register = return_register_;
 }
 
-void BranchEqual::exec(State &state) {
-  if (state.registers[first] == state.registers[second]) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchEqual::decode() const {
+  return {Opcode::BranchEqual, zero, first, second, 0, target};
 }
  
 BranchEqual::BranchEqual(vector<string> args) {
@@ -373,10 +374,8 @@ BranchEqual::BranchEqual(vector<string> args) {
   second = second_;
 }
 
-void BranchEqualZero::exec(State &state) {
-  if (state.registers[first] == 0) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchEqualZero::decode() const {
+  return {Opcode::BranchEqualZero, zero, first, zero, 0, target};
 }
  
 BranchEqualZero::BranchEqualZero(vector<string> args) {
@@ -390,10 +389,8 @@ BranchEqualZero::BranchEqualZero(vector<string> args) {
   first = first_;
 }
 
-void BranchNotEqual::exec(State &state) {
-  if (state.registers[first] != state.registers[second]) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchNotEqual::decode() const {
+  return {Opcode::BranchNotEqual, zero, first, second, 0, target};
 }
  
 BranchNotEqual::BranchNotEqual(vector<string> args) {
@@ -409,10 +406,8 @@ BranchNotEqual::BranchNotEqual(vector<string> args) {
   second = second_;
 }
 
-void BranchLessThen::exec(State &state) {
-  if (state.registers[first] < state.registers[second]) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchLessThen::decode() const {
+  return {Opcode::BranchLessThen, zero, first, second, 0, target};
 }
  
 BranchLessThen::BranchLessThen(vector<string> args) {
@@ -428,10 +423,8 @@ BranchLessThen::BranchLessThen(vector<string> args) {
   second = second_;
 }
 
-void BranchGreaterEqual::exec(State &state) {
-  if (state.registers[first] >= state.registers[second]) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchGreaterEqual::decode() const {
+  return {Opcode::BranchGreaterEqual, zero, first, second, 0, target};
 }
  
 BranchGreaterEqual::BranchGreaterEqual(vector<string> args) {
@@ -460,13 +453,13 @@ BranchGreaterThen::BranchGreaterThen(vector<string> args) {
   second = second_;
 }
 
-void BranchGreaterThen::exec(State &state) {
-  if (state.registers[first] > state.registers[second]) {
-    state.registers[pc] = (state.labels[label] - 1) * INSTRUCTION_SIZE;
-  }
+DecodedInstruction BranchGreaterThen::decode() const {
+  return {Opcode::BranchGreaterThen, zero, first, second, 0, target};
 }
 
-void Return::exec(State &state) { state.registers[pc] = state.registers[ra]; }
+DecodedInstruction Return::decode() const {
+  return {Opcode::Return};
+}
 
 Return::Return(vector<string> args) {
   int args_amount = 0;
@@ -476,9 +469,8 @@ Return::Return(vector<string> args) {
 }
 
 
-void Sb::exec(State &state) {
-  state.memory[state.registers[dst] + offset] = (std::byte) (state.registers[src] & 0xFF);
-  //  SB instructions store 8-bit values from the low bits of register rs2 to memory.
+DecodedInstruction Sb::decode() const {
+  return {Opcode::Sb, zero, dst, src, offset};
 }
 
 Sb::Sb(vector<string> args) {
@@ -498,12 +490,8 @@ Sb::Sb(vector<string> args) {
 }
 
 
-void Sh::exec(State & state) {
-  state.memory[state.registers[dst] + offset + 3] = (std::byte) ((state.registers[src] >> 24) & 0xFF);
-  state.memory[state.registers[dst] + offset + 2] = (std::byte) ((state.registers[src] >> 16) & 0xFF);
-  state.memory[state.registers[dst] + offset + 1] = (std::byte) ((state.registers[src] >> 8) & 0xFF);
-  state.memory[state.registers[dst] + offset] = (std::byte) (state.registers[src] & 0xFF);
-  // The SH store 16-bit value from the low bits of register rs2 to memory.
+DecodedInstruction Sh::decode() const {
+  return {Opcode::Sh, zero, dst, src, offset};
 }
 
 Sh::Sh(vector<string> args) {
@@ -521,24 +509,8 @@ Sh::Sh(vector<string> args) {
   offset = offset_;
 }
 
-void Sw::exec(State &state) {
-/*
-  n = 4321
-  stack s
-  s[0] = 1 < *10^0
-  s[1] = 2 < *10^1
-  s[2] = 3 < *10^2
-  s[3] = 4 < *10^3
-*/
-  state.memory[state.registers[dst] + offset + 7] = (std::byte) ((state.registers[src] >> 56) & 0xFF);
-  state.memory[state.registers[dst] + offset + 6] = (std::byte) ((state.registers[src] >> 48) & 0xFF);
-  state.memory[state.registers[dst] + offset + 5] = (std::byte) ((state.registers[src] >> 40) & 0xFF);
-  state.memory[state.registers[dst] + offset + 4] = (std::byte) ((state.registers[src] >> 32) & 0xFF);
-  state.memory[state.registers[dst] + offset + 3] = (std::byte) ((state.registers[src] >> 24) & 0xFF);
-  state.memory[state.registers[dst] + offset + 2] = (std::byte) ((state.registers[src] >> 16) & 0xFF);
-  state.memory[state.registers[dst] + offset + 1] = (std::byte) ((state.registers[src] >> 8) & 0xFF);
-  state.memory[state.registers[dst] + offset] = (std::byte) (state.registers[src] & 0xFF);
-  // The SW, SH, and SB instructions store 64-bit, 32-bit, and 16-bit values from the low bits of register rs2 to memory.
+DecodedInstruction Sw::decode() const {
+  return {Opcode::Sw, zero, dst, src, offset};
 }
 
 Sw::Sw(vector<string> args) {
@@ -556,24 +528,8 @@ Sw::Sw(vector<string> args) {
   offset = offset_;
 }
 
-void Lw::exec(State &state) {
-/*
-  n = 4321
-  stack s
-  s[0] = 1 < *10^0
-  s[1] = 2 < *10^1
-  s[2] = 3 < *10^2
-  s[3] = 4 < *10^3
-*/
-  std::byte eighth = state.memory[state.registers[src] + offset];
-  std::byte seventh = state.memory[state.registers[src] + offset + 1];
-  std::byte sixth = state.memory[state.registers[src] + offset + 2];
-  std::byte fifth = state.memory[state.registers[src] + offset + 3];
-  std::byte fourth = state.memory[state.registers[src] + offset + 4];
-  std::byte third = state.memory[state.registers[src] + offset + 5];
-  std::byte second = state.memory[state.registers[src] + offset + 6];
-  std::byte first = state.memory[state.registers[src] + offset + 7];
-  state.registers[dst] = (long) ((((long) first) << 56) | (((long) second) << 48) | (((long) third) << 40) | (((long) fourth) << 32) | (((long) fifth) << 24) | (((long) sixth) << 16) | (((long) seventh) << 8) | (long) eighth);
+DecodedInstruction Lw::decode() const {
+  return {Opcode::Lw, dst, src, zero, offset};
 }
 
 Lw::Lw(vector<string> args) {
@@ -591,12 +547,8 @@ Lw::Lw(vector<string> args) {
   offset = offset_;
 }
 
-void Lh::exec(State &state) {
-  std::byte fourth = state.memory[state.registers[src] + offset];
-  std::byte third = state.memory[state.registers[src] + offset + 1];
-  std::byte second = state.memory[state.registers[src] + offset + 2];
-  std::byte first = state.memory[state.registers[src] + offset + 3];
-  state.registers[dst] = (long) ((((long) first << 24)) | (long) (second) << 16 | (long) third << 8 | (long) fourth);
+DecodedInstruction Lh::decode() const {
+  return {Opcode::Lh, dst, src, zero, offset};
 }
 
 Lh::Lh(vector<string> args) {
@@ -615,9 +567,8 @@ Lh::Lh(vector<string> args) {
   offset = offset_;
 }
 
-void Lb::exec(State &state) {
-  std::byte first = state.memory[state.registers[src] + offset];
-  state.registers[dst] = (long) (first);
+DecodedInstruction Lb::decode() const {
+  return {Opcode::Lb, dst, src, zero, offset};
 }
 
 Lb::Lb(vector<string> args) {
@@ -636,8 +587,8 @@ Lb::Lb(vector<string> args) {
 }
 
 
-void La::exec(State &state) {
-  state.registers[dst] = state.labels[label] * INSTRUCTION_SIZE;
+DecodedInstruction La::decode() const {
+  return {Opcode::La, dst, zero, zero, 0, target};
 }
 
 La::La(vector<string> args) {
@@ -658,7 +609,9 @@ EBreak::EBreak(vector<string> args) {
   }
 }
 
-void EBreak::exec(State& state) { }
+DecodedInstruction EBreak::decode() const {
+  return {Opcode::EBreak};
+}
 
 
 Data::Data(vector<string> args) {
@@ -666,6 +619,6 @@ Data::Data(vector<string> args) {
   content = Parser::get_immediate(args[0]);
 }
 
-void Data::exec(State& state) {
-  throw RuntimeException("DATA SECTION CANNOT BE EXECUTED");
+DecodedInstruction Data::decode() const {
+  return {Opcode::Data, zero, zero, zero, content};
 }
@@ -0,0 +1,22 @@
+#include "BasicBlock.hpp"
+
+std::vector<bool> find_block_leaders(const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels) {
+    const size_t size = program.size();
+    std::vector<bool> leaders(size + 1, false);
+    leaders[0] = true;
+    for (const auto& [label, target] : labels) {
+        if (target >= 0 && (size_t) target <= size) {
+            leaders[target] = true;
+        }
+    }
+    for (size_t i = 0; i < size; i++) {
+        const DecodedInstruction& instruction = program[i];
+        if (is_control(instruction.opcode) || uses_pc(instruction) || instruction.opcode == Opcode::Ecall) {
+            leaders[i + 1] = true;
+        }
+        if (is_control(instruction.opcode) && instruction.opcode != Opcode::Return) {
+            leaders[instruction.target] = true;
+        }
+    }
+    return leaders;
+}
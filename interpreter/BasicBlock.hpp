@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../instructions/Instruction.hpp"
+
+// generated code of a block: runs it and returns the pc it continues at,
+// adds the instructions it retired to *executed
+using NativeBlock = unsigned long (*)(long* registers, std::byte* memory, unsigned long* executed);
+
+/*  Straight-line run of instructions translated once by interpret_blocks().
+    body is executed without any pc bookkeeping, the optional exit instruction
+    (a control instruction or one that needs pc) runs last with pc set.
+    taken and next cache the blocks the exit continues at, so a loop runs
+    from block to block without looking anything up. */
+struct BasicBlock {
+    size_t start;
+    size_t end;                 // index after the last instruction
+    size_t length;              // instructions retired by one run of the block
+    size_t dispatches;          // records executed, fewer than length with superinstructions
+
+    std::vector<const DecodedInstruction*> body;
+    const DecodedInstruction* exit = nullptr;
+    size_t exit_index = 0;
+
+    size_t taken_index = 0;     // target of the exit, if it has one
+    BasicBlock* taken = nullptr;
+    BasicBlock* next = nullptr;
+
+    // set by the JIT once the block is hot, native_exit tells if the code
+    // covers the exit too or leaves it to the interpreter
+    unsigned long entries = 0;
+    NativeBlock native = nullptr;
+    bool native_exit = false;
+};
+
+// true for every index a basic block starts at: 0, labels, targets of control
+// instructions and the instruction after a control instruction, an ecall or
+// an instruction using pc; the vector has one entry past the end
+std::vector<bool> find_block_leaders(const std::vector<DecodedInstruction>& program, const std::map<std::string, int>& labels);
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <bit>
 #include <cstddef>
 #include <ios>
 #include <iostream>
@@ -6,8 +7,15 @@
 #include <string>
 #include <vector>
 
+#include "../exceptions/ExitException.hpp"
 #include "../exceptions/RuntimeException.hpp"
 #include "../frontend/Parser.hpp"
+#include "../frontend/Reassembler.hpp"
+#include "../instructions/encoding.hpp"
+#include "../instructions/execute.hpp"
+#include "../instructions/fusion.hpp"
+#include "../jit/Jit.hpp"
+#include "../aot/AotModule.hpp"
 #include "Interpreter.hpp"
 
 const int SHOW_REGISTER_CMD_LEN = 14;
@@ -103,6 +111,8 @@ int Interpreter::process_request(std::string request) {
         step_out();
         stop = false;
         return 0;
+    } else if (request == "reload" || request == "r") {
+        return reload();
     } else if (request == "help") {
         if (!graph_flag) {
             show_help();        
@@ -134,6 +144,9 @@ void Interpreter::open_interface() {
     if (!debug) {
         return;
     }
+    if (watch && reassembler_->modified()) {
+        reload();
+    }
     stop = true;
     show_context();
     int failed_requests = 0;
@@ -158,19 +171,18 @@ void Interpreter::show_memory(size_t from, size_t to) {
     std::cout << "SHOWING MEMORY" << std::endl;
     for (int i = from; i < to; i++) {
         std::cout << "[" << i * 8 << "]: ";
-        long word = 0;
-        for (int j = 7; j > -1; j--) {
-            word = word << 8;
-            word += (int)global_state->memory[i * 8 + j];
+        if (!global_state->memory.contains(i * 8, 8)) {
+            std::cout << "OUT OF MEMORY" << std::endl;
+            break;
         }
-        std::cout << get_hex(word) << std::endl;
+        std::cout << get_hex(global_state->memory.load<long>(i * 8)) << std::endl;
     }
 }
 
 void Interpreter::show_registers() {
     std::cout << "SHOWING REGISTERS" << std::endl;
-    for (auto iter = Parser::registers_names.begin(); iter != Parser::registers_names.end(); ++iter) {
-        std::cout << iter->first << ": " << get_hex(global_state->registers[iter->second]) << std::endl;
+    for (const auto& [name, reg] : Parser::get_register_names()) {
+        std::cout << name << ": " << get_hex(global_state->registers[reg]) << std::endl;
     }
 }
 
@@ -183,24 +195,48 @@ void Interpreter::show_register(std::string rg_str) {
     }
 }
 
-Interpreter::Interpreter(std::vector<Instruction *>& instructions, std::map<std::string, int>& labels, std::vector<std::string>& all_lines, std::vector<int>& in_to_inparse, std::vector<int>& inparse_to_in, bool debug_flag, bool graph)
-    : exit(false), instructions_(instructions), global_state(new State(labels)), debug(debug_flag), 
-    all_lines_in(all_lines), from_in_to_inparse(in_to_inparse), from_inparse_to_in(inparse_to_in), graph_flag(graph) {
+Interpreter::Interpreter(std::vector<DecodedInstruction> instructions, std::map<std::string, int>& labels, std::vector<std::string>& all_lines, std::vector<int>& in_to_inparse, std::vector<int>& inparse_to_in, bool debug_flag, bool graph, unsigned long memory_size, std::vector<uint64_t> image)
+    : exit(false), instructions_(std::move(instructions)), original_instructions_(instructions_), image_(std::move(image)), global_state(new State(memory_size)), labels(labels), debug(debug_flag), 
+    all_lines_in(all_lines), from_in_to_inparse(in_to_inparse), from_inparse_to_in(inparse_to_in), graph_flag(graph), memory_size(memory_size) {
+    load_program();
+}
+
+// writes the program image into a fresh state from address 0, pc at the first instruction and sp at
+// the top of memory, so the stack grows down towards the image instead of over it, without breakpoints
+void Interpreter::load_program() {
+    break_points.assign(instructions_.size() + 1, false);
+    set_manually.assign(instructions_.size() + 1, false);
     bool instructions_starts = false;
-    for (auto instruction : instructions_) {
-        long to_mem = 0xDEADDEADDEADDEAD;
-        auto data = dynamic_cast<Data *>(instruction);
-        if (data != nullptr) {
-            to_mem = data->content;
-        } else if (!instructions_starts) {
-            global_state->registers[pc] = global_state->registers[sp];
-            instructions_starts = true;
+    size_t code_end = 0;
+    long address = 0;
+    // an image from the program cache is the one encode_slot() would give
+    const bool encoded = image_.size() == instructions_.size();
+    if (!encoded) {
+        image_.clear();
+        image_.reserve(instructions_.size());
+    }
+    for (size_t i = 0; i < instructions_.size(); i++) {
+        const DecodedInstruction& instruction = instructions_[i];
+        if (instruction.opcode != Opcode::Data) {
+            if (!instructions_starts) {
+                global_state->registers[pc] = address;
+                global_state->code.start = address;
+                instructions_starts = true;
+            }
+            code_end = (i + 1) * INSTRUCTION_SIZE;
         }
-        for (int i = 0; i < 8; i++) {
-            global_state->memory[global_state->registers[sp]] = (std::byte) ((to_mem >> (i * BYTE_BITS)) & 0xFF);
-            global_state->registers[sp] += 1;
+        if (!encoded) {
+            image_.push_back(encode_slot(instruction, i));
         }
+        global_state->memory.store<uint64_t>(address, image_[i]);
+        address += INSTRUCTION_SIZE;
+    }
+    // the slot above sp stays free for programs that store at 0(sp) before they move it
+    global_state->registers[sp] = global_state->memory.size() / 16 * 16 - 16;
+    if (instructions_starts) {
+        global_state->code.size = code_end - global_state->code.start;
     }
+    global_state->decoded = instructions_.data();
 }
 
 bool Interpreter::has_lines() {
@@ -212,48 +248,350 @@ bool Interpreter::is_break() {
 }
   
 
+// every engine keeps pc at a load or store, so a fault reports the instruction that made it
 void Interpreter::interpret() {
-    if (exit) {
+    long fault = 0;
+    if (!global_state->memory.run_guarded([this] { run_engine(); }, fault)) {
+        throw RuntimeException("Memory access out of range: " + std::to_string(fault) + " at pc "
+            + std::to_string(global_state->registers[pc]) + " in line " + std::to_string(get_line() + 1));
+    }
+}
+
+/*  The translating engines run what they took from the decode cache: they stop at
+    the first store into code and the switch loop goes on from there, re-decoding
+    every overwritten instruction it reaches. */
+void Interpreter::run_engine() {
+    if (debug) {
+        interpret_switch<true>();
+        return;
+    }
+    if (aot_ != nullptr && !global_state->code_written && interpret_aot()) {
         return;
     }
-    bool first = true;
+    if (!global_state->code_written && unparsed == 0) {
+        if (engine == Engine::Threaded) {
+            interpret_threaded();
+        } else if (engine == Engine::Blocks) {
+            interpret_blocks();
+        } else if (engine == Engine::Jit || engine == Engine::Tiered) {
+            if (jit_ == nullptr && Jit::supported()) {
+                jit_ = std::make_unique<Jit>();
+            }
+            interpret_blocks();
+        }
+    }
+    if (engine == Engine::Switch || global_state->code_written || unparsed != 0) {
+        interpret_switch<false>();
+    }
+}
 
-    if (first_instruction) {
-        first = false;
-        first_instruction = false;
+/*  Both versions run the program with one switch dispatch per instruction and
+    a single unsigned compare on pc: pc is rotated right by log2(INSTRUCTION_SIZE),
+    so an out of range and a misaligned pc are both rejected, the misaligned case
+    is told apart after the loop.
+    Debug = true stops on ebreak and on breakpoints, which are Opcode::Trap entries
+    patched into instructions_, so it runs at the same speed between stops.
+    A superinstruction is one dispatch retiring fused_length() instructions.
+    An Opcode::Stale entry is re-decoded from memory and dispatched again,
+    an Opcode::Unparsed entry is parsed and dispatched again, and so is a load
+    or store of a slot that is still unparsed, once that slot is parsed. */
+template <bool Debug>
+void Interpreter::interpret_switch() {
+    if (exit) {
+        return;
     }
+    unsigned long executed = 0;     // kept local, a member counter is reloaded after every store
+    unsigned long removed = 0;
+    auto flush_counters = [&]() {
+        retired += executed;
+        removed_dispatches += removed;
+    };
+
+    long* registers = global_state->registers.data();
+    DecodedInstruction* program = instructions_.data();
+    const unsigned long size = instructions_.size();
+    constexpr int shift = std::countr_zero((unsigned long) INSTRUCTION_SIZE);
+    size_t index;
 
-    while(has_lines()) {
-        if (global_state->registers[pc] % INSTRUCTION_SIZE != 0) {
-            throw RuntimeException("Wrong pc: " + std::to_string(global_state->registers[pc]));
+    try {
+        if constexpr (Debug) {
+            bool first = !first_instruction;
+            first_instruction = false;
+
+            index = std::rotr((unsigned long) registers[pc], shift);
+            if (first && index < size) {
+                // resuming from a stop: the instruction under pc runs even if it is a breakpoint
+                if (accesses_memory(original_instruction(index).opcode) && unparsed != 0) {
+                    parse_accessed_code(original_instruction(index));
+                }
+                execute(original_instruction(index), *global_state);
+                registers[pc] += INSTRUCTION_SIZE;
+                ++executed;
+                index = std::rotr((unsigned long) registers[pc], shift);
+            }
+            if (break_on_next && index < size) {
+                stop_at(index);
+                flush_counters();
+                return;
+            }
         }
 
-        size_t index = global_state->registers[pc] / INSTRUCTION_SIZE;
+        while (true) {
+            index = std::rotr((unsigned long) registers[pc], shift);
+            if (index >= size) {
+                break;
+            }
 
-        if (!first && debug && ((dynamic_cast<EBreak *>(instructions_[index]) != nullptr || break_points[index] == 1) || break_on_next)) { 
-            break_on_next = false;
-            stop = true;
-            if (!set_manually[index]) {
-                break_points[index] = 0;
+            switch (program[index].opcode) {
+#define OPCODE_CASE(name)                                                                   \
+                case Opcode::name:                                                              \
+                    if (Debug && (Opcode::name == Opcode::Trap || Opcode::name == Opcode::EBreak)) { \
+                        stop_at(index);                                                         \
+                        flush_counters();                                                       \
+                        return;                                                                 \
+                    }                                                                           \
+                    if (Opcode::name == Opcode::Stale) {                                        \
+                        redecode(index);                                                        \
+                        continue;                                                               \
+                    }                                                                           \
+                    if (Opcode::name == Opcode::Unparsed) {                                     \
+                        parse_lazily(index);                                                    \
+                        continue;                                                               \
+                    }                                                                           \
+                    if (accesses_memory(leading_opcode(Opcode::name)) && unparsed != 0          \
+                            && parse_accessed_code(program[index])) {                           \
+                        continue;                                                               \
+                    }                                                                           \
+                    execute_fused<Opcode::name>(&program[index], *global_state);                \
+                    if constexpr (fused_length(Opcode::name) > 1) {                             \
+                        executed += fused_length(Opcode::name) - 1;                             \
+                        removed += fused_length(Opcode::name) - 1;                              \
+                    }                                                                           \
+                    break;
+#define FUSED_CASE(name, first, rest) OPCODE_CASE(name)
+                OPCODE_LIST(OPCODE_CASE)
+                FUSED_LIST(FUSED_CASE)
+#undef FUSED_CASE
+#undef OPCODE_CASE
             }
-            return;
+            registers[pc] += INSTRUCTION_SIZE;
+            ++executed;
         }
-        
-
-        instructions_[global_state->registers[pc] / INSTRUCTION_SIZE]->exec(*global_state);
-        global_state->registers[pc] += INSTRUCTION_SIZE;
-        first = false;
+    } catch (const ExitException&) {
+        // the exit ecall retired as well
+        ++executed;
+        flush_counters();
+        throw;
+    }
+    flush_counters();
 
-        if (exit) {
+    if ((unsigned long) registers[pc] < size * INSTRUCTION_SIZE) {
+        throw RuntimeException("Wrong pc: " + std::to_string(registers[pc]));
+    }
+    if constexpr (Debug) {
+        if (has_break_point(registers[pc] / INSTRUCTION_SIZE - 1) || break_on_next) {
+            stop = true;
             return;
         }
     }
+}
+
+template void Interpreter::interpret_switch<true>();
+template void Interpreter::interpret_switch<false>();
+
+void Interpreter::stop_at(size_t index) {
+    break_on_next = false;
+    stop = true;
+    if (index >= set_manually.size() || !set_manually[index]) {
+        set_break_point(index, false);
+    }
+}
 
-    if (debug && (break_points[global_state->registers[pc] / INSTRUCTION_SIZE - 1] == 1 || break_on_next)) {
-        stop = true;
+void Interpreter::set_break_point(size_t index, bool value) {
+    if (index >= break_points.size()) {
         return;
     }
+    break_points[index] = value;
+    if (index >= instructions_.size()) {
+        return;
+    }
+    // superinstructions covering index are split while it has a breakpoint
+    size_t from = index >= MAX_FUSED_LENGTH - 1 ? index - (MAX_FUSED_LENGTH - 1) : 0;
+    for (size_t i = from; i <= index; i++) {
+        refresh_instruction(i);
+    }
+}
+
+// decodes the slot again if guest memory no longer holds what original_instructions_ was decoded from,
+// an instruction without an encoding stays as parsed until its slot is written
+void Interpreter::sync_slot(size_t index) {
+    const uint64_t slot = global_state->memory.load<uint64_t>(index * INSTRUCTION_SIZE);
+    if (slot != image_[index]) {
+        unparsed -= original_instructions_[index].opcode == Opcode::Unparsed;
+        image_[index] = slot;
+        original_instructions_[index] = decode_slot(slot, index);
+    }
+}
+
+// the stale entries a superinstruction at index could cover first, so it fuses what is in memory now
+void Interpreter::redecode(size_t index) {
+    const size_t end = std::min(index + MAX_FUSED_LENGTH, instructions_.size());
+    for (size_t i = end; i-- > index;) {
+        if (instructions_[i].opcode == Opcode::Stale) {
+            refresh_instruction(i);
+        }
+    }
+}
+
+void Interpreter::refresh_instruction(size_t index) {
+    const size_t end = std::min(index + MAX_FUSED_LENGTH, instructions_.size());
+    for (size_t i = index; i < end; i++) {
+        sync_slot(i);
+    }
+    DecodedInstruction instruction = original_instructions_[index];
+    if (has_break_point(index)) {
+        instruction.opcode = Opcode::Trap;
+    } else if (fusion) {
+        Opcode fused = fuse_at(original_instructions_, index);
+        bool covers_break_point = false;
+        for (int i = 1; i < fused_length(fused); i++) {
+            covers_break_point |= has_break_point(index + i);
+        }
+        if (!covers_break_point) {
+            instruction.opcode = fused;
+        }
+    }
+    instructions_[index] = instruction;
+}
+
+void Interpreter::enable_lazy_parsing(std::unique_ptr<Parser> parser) {
+    parser_ = std::move(parser);
+    unparsed = std::count_if(original_instructions_.begin(), original_instructions_.end(),
+        [](const DecodedInstruction& instruction) { return instruction.opcode == Opcode::Unparsed; });
+}
+
+// the slot gets the encoding, superinstructions ending at index can form now
+void Interpreter::parse_lazily(size_t index) {
+    DecodedInstruction instruction;
+    try {
+        instruction = parser_->parse_line(index, original_instructions_[index].immediate);
+    } catch (const ParserException& e) {
+        throw RuntimeException(e.get_message());
+    }
+    original_instructions_[index] = instruction;
+    image_[index] = encode_slot(instruction, index);
+    global_state->memory.store<uint64_t>(index * INSTRUCTION_SIZE, image_[index]);
+    --unparsed;
+    size_t from = index >= MAX_FUSED_LENGTH - 1 ? index - (MAX_FUSED_LENGTH - 1) : 0;
+    for (size_t i = from; i <= index; i++) {
+        refresh_instruction(i);
+    }
+}
+
+// a load or store of code has to see the encoding of its lines, true if any was parsed
+bool Interpreter::parse_accessed_code(const DecodedInstruction& instruction) {
+    const unsigned long address = global_state->registers[instruction.rs1] + instruction.immediate;
+    const size_t first = address / INSTRUCTION_SIZE;
+    // an access is at most 8 bytes, so it touches at most two slots
+    const size_t last = (address + sizeof(uint64_t) - 1) / INSTRUCTION_SIZE;
+    bool parsed = false;
+    for (size_t index = first; index <= last && index < instructions_.size(); index++) {
+        if (original_instructions_[index].opcode == Opcode::Unparsed) {
+            parse_lazily(index);
+            parsed = true;
+        }
+    }
+    return parsed;
+}
 
+void Interpreter::enable_reload(std::unique_ptr<Reassembler> reassembler, bool watched) {
+    reassembler_ = std::move(reassembler);
+    watch = watched;
+}
+
+// translated and compiled blocks, and the aot module, were made from the old records
+void Interpreter::drop_translations() {
+    blocks_.clear();
+    block_leaders.clear();
+    jit_.reset();
+    aot_.reset();
+}
+
+int Interpreter::reload() {
+    if (reassembler_ == nullptr) {
+        if (!graph_flag) {
+            std::cout << "NO SOURCE TO RELOAD" << std::endl;
+        }
+        return 1;
+    }
+    Reassembler::Reassembly reassembly;
+    try {
+        if (!reassembler_->reassemble(original_instructions_, reassembly)) {
+            return 0;
+        }
+    } catch (const PreprocessorException& e) {
+        if (!graph_flag) {
+            std::cout << "RELOAD FAILED: " << e.get_message() << std::endl;
+        }
+        return 1;
+    } catch (const ParserException& e) {
+        if (!graph_flag) {
+            std::cout << "RELOAD FAILED: " << e.get_message() << std::endl;
+        }
+        return 1;
+    }
+    if (reassembly.full) {
+        // the lazy parser reads the text of the old pass
+        parser_.reset();
+    }
+    unparsed = reassembly.unparsed;
+    drop_translations();
+
+    if (reassembly.same_layout) {
+        for (size_t index : reassembly.changed) {
+            original_instructions_[index] = reassembly.instructions[index];
+            image_[index] = encode_slot(original_instructions_[index], index);
+            global_state->memory.store<uint64_t>(index * INSTRUCTION_SIZE, image_[index]);
+        }
+        for (size_t index : reassembly.changed) {
+            size_t from = index >= MAX_FUSED_LENGTH - 1 ? index - (MAX_FUSED_LENGTH - 1) : 0;
+            for (size_t i = from; i <= index; i++) {
+                refresh_instruction(i);
+            }
+        }
+        if (!graph_flag) {
+            std::cout << "RELOADED: " << reassembly.changed.size() << " INSTRUCTIONS CHANGED" << std::endl;
+        }
+        return 0;
+    }
+
+    // indices and addresses mean something else now, the run starts over
+    delete global_state;
+    global_state = new State(memory_size);
+    instructions_ = std::move(reassembly.instructions);
+    original_instructions_ = instructions_;
+    image_.clear();
+    load_program();
+    break_on_next = false;
+    first_instruction = true;
+    if (fusion) {
+        enable_fusion();
+    }
+    if (!graph_flag) {
+        std::cout << "RELOADED: PROGRAM RESTARTED" << std::endl;
+    }
+    return 0;
+}
+
+void Interpreter::enable_fusion() {
+    fusion = true;
+    fused_sites = 0;
+    for (size_t i = 0; i < instructions_.size(); i++) {
+        refresh_instruction(i);
+        if (fused_length(instructions_[i].opcode) > 1) {
+            ++fused_sites;
+        }
+    }
 }
 
 void Interpreter::show_context() {
@@ -284,9 +622,9 @@ void Interpreter::show_context() {
 }
 
 int Interpreter::breakpoint_set_by_label(std::string label) {
-    if (global_state->labels.find(label) != global_state->labels.cend()) {
-        break_points[global_state->labels[label]] = 1;
-        set_manually[global_state->labels[label]] = 1;
+    if (labels.find(label) != labels.cend()) {
+        set_break_point(labels[label], true);
+        set_manual(labels[label], true);
         return 0;
     } else {
         if (!graph_flag) {
@@ -305,8 +643,8 @@ int Interpreter::breakpoint_set_by_number(int num) {
             }
             return 4;
         }
-        break_points[from_in_to_inparse[num]] = 1;
-        set_manually[from_in_to_inparse[num]] = 1;
+        set_break_point(from_in_to_inparse[num], true);
+        set_manual(from_in_to_inparse[num], true);
         return 0;
     } else {
         if (!graph_flag) {
@@ -317,9 +655,9 @@ int Interpreter::breakpoint_set_by_number(int num) {
 }
 
 int Interpreter::breakpoint_delete_by_label(std::string label) {
-    if (global_state->labels.find(label) != global_state->labels.cend()) {
-        break_points[global_state->labels[label]] = 0;
-        set_manually[global_state->labels[label]] = 0;
+    if (labels.find(label) != labels.cend()) {
+        set_break_point(labels[label], false);
+        set_manual(labels[label], false);
         return 0;
     } else {
         if (!graph_flag) {
@@ -339,8 +677,8 @@ int Interpreter::breakpoint_delete_by_number(int num) {
             }
             return 4;
         }
-        break_points[from_in_to_inparse[num]] = 0;
-        set_manually[from_in_to_inparse[num]] = 0;
+        set_break_point(from_in_to_inparse[num], false);
+        set_manual(from_in_to_inparse[num], false);
         return 0;
     } else {
         if (!graph_flag) {
@@ -354,8 +692,8 @@ int Interpreter::breakpoint_delete_by_number(int num) {
 void Interpreter::step_over() {
     size_t index = global_state->registers[pc] / INSTRUCTION_SIZE;
 
-    if (index < instructions_.size() && (dynamic_cast<JumpAndLink *>(instructions_[index]) != nullptr || dynamic_cast<Call *>(instructions_[index]) != nullptr)) {
-        break_points[index + 1] = 1;
+    if (index < instructions_.size() && (original_instruction(index).opcode == Opcode::JumpAndLink || original_instruction(index).opcode == Opcode::Call)) {
+        set_break_point(index + 1, true);
         return;
     } else {
         break_on_next = true;
@@ -367,7 +705,7 @@ void Interpreter::step_in() {
 }
 
 void Interpreter::step_out() {
-    break_points[(global_state->registers[ra] / INSTRUCTION_SIZE) + 1] = 1;
+    set_break_point((global_state->registers[ra] / INSTRUCTION_SIZE) + 1, true);
 }
 
 void Interpreter::show_help() {
@@ -381,23 +719,65 @@ void Interpreter::show_help() {
     std::cout << "- step in (s): Execute the next instruction and step into any function calls." << std::endl;
     std::cout << "- step over (n): Execute the next instruction and skip over any function calls." << std::endl;
     std::cout << "- step out (o): Execute until the current function returns." << std::endl;
+    std::cout << "- reload (r): Assemble the edited source again, keeping the state if the layout did not change." << std::endl;
     std::cout << "- help: Show this help message." << std::endl;
 }
 
 bool Interpreter::is_breakpoint(size_t num) {
     if (from_in_to_inparse[num] >= 0) {
-        return break_points[from_in_to_inparse[num]] & set_manually[from_in_to_inparse[num]];
+        const size_t index = from_in_to_inparse[num];
+        return has_break_point(index) && set_manually[index];
     }
     return false;
 }
 
 Interpreter::~Interpreter() {
-    for (Instruction *instruction : instructions_) {
-        delete instruction;
-    }
     delete global_state;
 }
 
+void Interpreter::set_engine(Engine engine_) {
+    engine = engine_;
+    block_threshold = engine == Engine::Tiered ? TIERED_BLOCK_THRESHOLD : 0;
+    jit_threshold = engine == Engine::Tiered ? TIERED_JIT_THRESHOLD : JIT_THRESHOLD;
+}
+
+unsigned long Interpreter::get_compiled_blocks() const {
+    return jit_ == nullptr ? 0 : jit_->get_compiled();
+}
+
+bool Interpreter::enable_aot(const std::string& path) {
+    if (unparsed != 0) {
+        return false;
+    }
+    auto module = std::make_unique<AotModule>();
+    if (!module->load(path, original_instructions_, labels)) {
+        return false;
+    }
+    aot_ = std::move(module);
+    return true;
+}
+
+bool Interpreter::aot_rebuilt() const {
+    return aot_ != nullptr && aot_->was_rebuilt();
+}
+
+// true if the program ran to its end, otherwise pc is where the engine goes on
+bool Interpreter::interpret_aot() {
+    if (exit) {
+        return true;
+    }
+    unsigned long executed = 0;
+    bool finished;
+    try {
+        finished = aot_->run(*global_state, executed);
+    } catch (const ExitException&) {
+        retired += executed;
+        throw;
+    }
+    retired += executed;
+    return finished;
+}
+
 std::string Interpreter::get_hex(long num) {
     std::string str;
     std::string nul;
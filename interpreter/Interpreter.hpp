@@ -1,16 +1,61 @@
 #pragma once
 
-#include <bitset>
+#include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "../instructions/Instruction.hpp"
-
+#include "BasicBlock.hpp"
+
+class Jit;
+class AotModule;
+class Parser;
+class Reassembler;
+
+enum class Engine {
+    Switch,     // interpret_switch(): one switch dispatch per instruction
+    Threaded,   // interpret_threaded(): direct-threaded handlers, release runs only
+    Blocks,     // interpret_blocks(): cached basic blocks chained together, release runs only
+    Jit,        // interpret_blocks() running hot blocks as x86-64 code, blocks elsewhere
+    Tiered,     // interpret_blocks() starting every block in the plain interpreter
+};
 
 class Interpreter { 
-    std::vector<Instruction *> instructions_;
+    // instructions_ is executed, it is the decode cache of the program image indexed
+    // by pc / INSTRUCTION_SIZE: breakpoints are patched in as Opcode::Trap, superinstructions
+    // replace the opcode of their first instruction and a store into code leaves Opcode::Stale.
+    // original_instructions_ keeps the program as decoded from the slots in image_.
+    std::vector<DecodedInstruction> instructions_;
+    std::vector<DecodedInstruction> original_instructions_;
+    std::vector<uint64_t> image_;
+
+    // one entry per instruction and one past the end, where a trailing label or a step
+    // over the last call points; sized by load_program()
+    std::vector<bool> break_points;
+    std::vector<bool> set_manually;
+    bool has_break_point(size_t index) const { return index < break_points.size() && break_points[index]; }
+    void set_manual(size_t index, bool value) {
+        if (index < set_manually.size()) {
+            set_manually[index] = value;
+        }
+    }
 
-    std::bitset<100000> break_points;
-    std::bitset<100000> set_manually;
+    bool fusion = false;
+    unsigned long fused_sites = 0;
+    unsigned long removed_dispatches = 0;
+
+    void set_break_point(size_t index, bool value);
+    void refresh_instruction(size_t index);
+    void sync_slot(size_t index);
+    void redecode(size_t index);
+    const DecodedInstruction& original_instruction(size_t index) {
+        if (original_instructions_[index].opcode == Opcode::Unparsed) {
+            parse_lazily(index);
+        }
+        return original_instructions_[index];
+    }
+    void stop_at(size_t index);
 
     State *global_state;
     bool exit;
@@ -20,6 +65,53 @@ class Interpreter {
     bool break_on_next = false;
 
     bool first_instruction = true;
+
+    unsigned long retired = 0;
+    Engine engine = Engine::Switch;
+
+    // the engine interpret() picks, run while memory faults are caught
+    void run_engine();
+    template <bool Debug>
+    void interpret_switch();
+    void interpret_threaded();
+    // handler of every instruction while interpret_threaded() runs
+    std::vector<const void*> threaded_code;
+    void interpret_blocks();
+
+    // translation cache of interpret_blocks(), indexed by the first instruction of a block
+    std::vector<std::unique_ptr<BasicBlock>> blocks_;
+    std::vector<bool> block_leaders;
+    unsigned long translated_blocks = 0;
+    std::unique_ptr<Jit> jit_;
+
+    // tier 0 runs a block instruction by instruction, entered block_threshold times
+    // it is translated (tier 1), entered jit_threshold more times it is compiled (tier 2)
+    unsigned long block_threshold = 0;
+    unsigned long jit_threshold = 0;
+    std::vector<unsigned long> cold_entries;
+    unsigned long tier_retired[3] = {0, 0, 0};
+    unsigned long run_cold(size_t index, unsigned long& executed);
+
+    // --lazy: Opcode::Unparsed records are parsed by parser_ when they are reached,
+    // only the switch loop runs while any is left
+    std::unique_ptr<Parser> parser_;
+    unsigned long unparsed = 0;
+    void parse_lazily(size_t index);
+    bool parse_accessed_code(const DecodedInstruction& instruction);
+
+    // reload and --watch: the program is patched in place if its layout stays, otherwise it starts over
+    std::unique_ptr<Reassembler> reassembler_;
+    bool watch = false;
+    unsigned long memory_size;
+    int reload();
+    void load_program();
+    void drop_translations();
+
+    // --aot: runs the program until it finishes or hands over to the engine
+    std::unique_ptr<AotModule> aot_;
+    bool interpret_aot();
+
+    BasicBlock* block_at(size_t index);
     
     void show_registers();
     void show_register(std::string rg);
@@ -39,6 +131,7 @@ class Interpreter {
 
     void show_help();
 
+    std::map<std::string, int>& labels;
     std::vector<std::string>& all_lines_in;
 
     std::vector<int>& from_in_to_inparse;
@@ -46,8 +139,9 @@ class Interpreter {
 
 
    public:
-    Interpreter(std::vector<Instruction *>& instructions, std::map<std::string, int>& labels, std::vector<std::string>& all_lines,
-                    std::vector<int>& in_to_inparse, std::vector<int>& inparse_to_in, bool debug, bool graph);
+    Interpreter(std::vector<DecodedInstruction> instructions, std::map<std::string, int>& labels, std::vector<std::string>& all_lines,
+                    std::vector<int>& in_to_inparse, std::vector<int>& inparse_to_in, bool debug, bool graph,
+                    unsigned long memory_size = DEFAULT_MEMORY_SIZE, std::vector<uint64_t> image = {});
 
     int get_line();
 
@@ -71,5 +165,30 @@ class Interpreter {
 
     bool is_break();
 
+    unsigned long get_retired() const { return retired; }
+    unsigned long get_resident_pages() const { return global_state->memory.resident_pages(); }
+    // also resets the tier thresholds to the defaults of the engine
+    void set_engine(Engine engine_);
+    void set_block_threshold(unsigned long threshold) { block_threshold = threshold; }
+    void set_jit_threshold(unsigned long threshold) { jit_threshold = threshold; }
+    unsigned long get_tier_retired(int tier) const { return tier_retired[tier]; }
+
+    void enable_fusion();
+    unsigned long get_fused_sites() const { return fused_sites; }
+    unsigned long get_removed_dispatches() const { return removed_dispatches; }
+    unsigned long get_translated_blocks() const { return translated_blocks; }
+    unsigned long get_compiled_blocks() const;
+
+    // parser has to be the one the Opcode::Unparsed records came from
+    void enable_lazy_parsing(std::unique_ptr<Parser> parser);
+    unsigned long get_unparsed() const { return unparsed; }
+
+    // the source the program was assembled from, watched reloads it whenever the debugger stops
+    void enable_reload(std::unique_ptr<Reassembler> reassembler, bool watched);
+
+    // loads or builds the shared object at path, false if neither works
+    bool enable_aot(const std::string& path);
+    bool aot_rebuilt() const;
+
     ~Interpreter();
 };
@@ -0,0 +1,209 @@
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../exceptions/RuntimeException.hpp"
+#include "../instructions/execute.hpp"
+#include "../jit/Jit.hpp"
+#include "Interpreter.hpp"
+
+/*  Basic block engine: a block starts at a label, at the target of a control
+    instruction or after one, and ends before the next start or after its exit.
+    Blocks are translated on first entry and kept in blocks_, the exit of a block
+    links to the block it continues at, so after warming up a loop runs without
+    lookups and without any per-instruction pc or end of program checks.
+    Blocks are tiered by the number of times they were entered: a block starts in
+    run_cold() unless block_threshold is 0, is translated once it crosses
+    block_threshold and, with the JIT, compiled once it crosses jit_threshold.
+    Translations are not invalidated: the loop stops at the first store into code,
+    or before an overwritten instruction of the running block, with pc at the
+    instruction to go on with, see Interpreter::run_engine(). */
+
+BasicBlock* Interpreter::block_at(size_t index) {
+    const size_t size = instructions_.size();
+    if (index >= size) {
+        return nullptr;
+    }
+    if (blocks_[index]) {
+        return blocks_[index].get();
+    }
+
+    auto block = std::make_unique<BasicBlock>();
+    block->start = index;
+    block->length = 0;
+    block->dispatches = 0;
+    size_t i = index;
+    do {
+        const DecodedInstruction& instruction = instructions_[i];
+        // a superinstruction runs as a whole, a start inside of it only matters for jumps
+        size_t span = fused_length(instruction.opcode);
+        block->length += span;
+        ++block->dispatches;
+        const DecodedInstruction& last = original_instructions_[i + span - 1];
+        if (is_control(last.opcode) || uses_pc(instruction) || instruction.opcode == Opcode::Ecall) {
+            block->exit = &instruction;
+            block->exit_index = i;
+            block->taken_index = last.target;
+            i += span;
+            break;
+        }
+        block->body.push_back(&instruction);
+        i += span;
+    } while (i < size && !block_leaders[i]);
+    block->end = i;
+
+    ++translated_blocks;
+    blocks_[index] = std::move(block);
+    return blocks_[index].get();
+}
+
+// tier 0: runs from index to the end of its block one instruction at a time, returns pc
+unsigned long Interpreter::run_cold(size_t index, unsigned long& executed) {
+    long* registers = global_state->registers.data();
+    const size_t size = instructions_.size();
+    while (true) {
+        const DecodedInstruction& instruction = instructions_[index];
+        const size_t span = fused_length(instruction.opcode);
+        registers[pc] = index * INSTRUCTION_SIZE;
+        if (instruction.opcode == Opcode::Stale) {
+            return registers[pc];
+        }
+        // counted first, an exit ecall does not come back
+        executed += span;
+        execute_fused(&instruction, *global_state);
+        registers[pc] += INSTRUCTION_SIZE;
+        const DecodedInstruction& last = original_instructions_[index + span - 1];
+        index += span;
+        if (is_control(last.opcode) || uses_pc(instruction) || instruction.opcode == Opcode::Ecall
+                || index >= size || block_leaders[index]) {
+            return registers[pc];
+        }
+    }
+}
+
+void Interpreter::interpret_blocks() {
+    if (exit) {
+        return;
+    }
+    const size_t size = instructions_.size();
+    if (block_leaders.empty()) {
+        blocks_.resize(size);
+        block_leaders = find_block_leaders(original_instructions_, labels);
+        cold_entries.assign(size, 0);
+    }
+    long* registers = global_state->registers.data();
+    unsigned long executed[3] = {0, 0, 0};      // per tier, kept local like in the other engines
+    unsigned long dispatched = 0;
+    auto flush_counters = [&]() {
+        for (int tier = 0; tier < 3; tier++) {
+            retired += executed[tier];
+            tier_retired[tier] += executed[tier];
+        }
+        // tier 0 dispatches once per record, like the switch loop
+        removed_dispatches += executed[1] + executed[2] - dispatched;
+    };
+
+    unsigned long address = registers[pc];
+    BasicBlock* block = nullptr;
+    BasicBlock** link = nullptr;    // chain of the previous block waiting for its successor
+    try {
+        while (true) {
+            if (block == nullptr) {
+                if (address >= size * INSTRUCTION_SIZE) {
+                    break;
+                }
+                if (address % INSTRUCTION_SIZE != 0) {
+                    throw RuntimeException("Wrong pc: " + std::to_string(address));
+                }
+                const size_t index = address / INSTRUCTION_SIZE;
+                block = blocks_[index].get();
+                if (block == nullptr) {
+                    if (cold_entries[index]++ < block_threshold) {
+                        link = nullptr;
+                        address = run_cold(index, executed[0]);
+                        if (global_state->code_written) {
+                            break;
+                        }
+                        continue;
+                    }
+                    block = block_at(index);
+                }
+                if (link != nullptr) {
+                    *link = block;
+                }
+            }
+
+            if (jit_ != nullptr && block->native == nullptr && block->entries++ == jit_threshold) {
+                block->native = jit_->compile(*block, original_instructions_, global_state->code, block->native_exit);
+            }
+
+            if (block->native != nullptr) {
+                registers[pc] = block->native(registers, global_state->memory.data(), &executed[2]);
+                const size_t stopped = registers[pc] / INSTRUCTION_SIZE;
+                const bool at_exit = block->exit != nullptr && !block->native_exit && stopped == block->exit_index;
+                if (!at_exit && stopped >= block->start && stopped < block->end) {
+                    // the native code left before a store into code, it runs here and marks the cache
+                    execute_fused(&instructions_[stopped], *global_state);
+                    registers[pc] += INSTRUCTION_SIZE;
+                    ++executed[1];
+                    ++dispatched;
+                } else if (at_exit && block->exit->opcode != Opcode::Stale) {
+                    // ecall or an instruction using pc, pc is already at it
+                    ++executed[1];
+                    ++dispatched;
+                    execute_fused(block->exit, *global_state);
+                    registers[pc] += INSTRUCTION_SIZE;
+                }
+            } else {
+                size_t done = 0;
+                for (; done < block->body.size(); done++) {
+                    const DecodedInstruction* instruction = block->body[done];
+                    // a store, not a check: the pc a memory fault reports
+                    registers[pc] = (instruction - instructions_.data()) * INSTRUCTION_SIZE;
+                    std::atomic_signal_fence(std::memory_order_seq_cst);
+                    if (instruction->opcode == Opcode::Stale) {
+                        break;
+                    }
+                    execute_fused(instruction, *global_state);
+                }
+                const bool stale_exit = block->exit != nullptr && block->exit->opcode == Opcode::Stale;
+                if (done < block->body.size() || stale_exit) {
+                    // overwritten since the block was translated, pc is at it
+                    const size_t stopped = done < block->body.size() ? block->body[done] - instructions_.data() : block->exit_index;
+                    registers[pc] = stopped * INSTRUCTION_SIZE;
+                    executed[1] += stopped - block->start;
+                    dispatched += done;
+                    break;
+                }
+                executed[1] += block->length;
+                dispatched += block->dispatches;
+
+                if (block->exit == nullptr) {
+                    registers[pc] = block->end * INSTRUCTION_SIZE;
+                } else {
+                    registers[pc] = block->exit_index * INSTRUCTION_SIZE;
+                    execute_fused(block->exit, *global_state);
+                    registers[pc] += INSTRUCTION_SIZE;
+                }
+            }
+
+            address = registers[pc];
+            if (global_state->code_written) {
+                break;
+            }
+            // follow the chain, or look the successor up and chain it once it is translated
+            if (address == block->end * INSTRUCTION_SIZE) {
+                link = &block->next;
+            } else if (block->exit != nullptr && address == block->taken_index * INSTRUCTION_SIZE) {
+                link = &block->taken;
+            } else {
+                link = nullptr;
+            }
+            block = link != nullptr ? *link : nullptr;
+        }
+    } catch (...) {
+        flush_counters();
+        throw;
+    }
+    flush_counters();
+}
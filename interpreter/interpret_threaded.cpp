@@ -0,0 +1,185 @@
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../exceptions/ExitException.hpp"
+#include "../exceptions/RuntimeException.hpp"
+#include "../instructions/execute.hpp"
+#include "Interpreter.hpp"
+
+/*  Direct-threaded engine: every instruction index gets the address of its handler,
+    each handler jumps straight to the handler of the next instruction.
+    pc is kept as an index while running and written back to the state on exit.
+    Instructions that read or write the pc register go through execute() with the
+    same pc bookkeeping as interpret_switch(), so their semantics stay the same.
+    A superinstruction runs its first instruction and jumps straight into the
+    handler of the rest without going through code[].
+    code[] is not kept in step with the decode cache: a store into code ends the
+    run after it, see Interpreter::run_engine(). */
+
+#if defined(__GNUC__)
+
+void Interpreter::interpret_threaded() {
+    if (exit) {
+        return;
+    }
+
+#define OPCODE_LABEL(name) &&op_##name,
+#define FUSED_LABEL(name, first, rest) OPCODE_LABEL(name)
+    static const void* const handlers[] = { OPCODE_LIST(OPCODE_LABEL) FUSED_LIST(FUSED_LABEL) };
+#undef FUSED_LABEL
+#undef OPCODE_LABEL
+
+    const DecodedInstruction* program = instructions_.data();
+    const size_t size = instructions_.size();
+    long* registers = global_state->registers.data();
+
+    // one extra slot past the end, reached by falling through or jumping to a trailing label;
+    // a member, since a memory fault leaves this frame without running destructors
+    threaded_code.assign(size + 1, nullptr);
+    const void** code = threaded_code.data();
+    for (size_t i = 0; i < size; i++) {
+        code[i] = uses_pc(program[i]) ? &&generic : handlers[static_cast<int>(program[i].opcode)];
+    }
+    code[size] = &&halt;
+
+    size_t index;
+    unsigned long executed = 0;
+    unsigned long removed = 0;
+
+#define DISPATCH() do { ++executed; goto *code[index]; } while (0)
+#define NEXT() do { ++index; DISPATCH(); } while (0)
+#define JUMP(target) do { index = (target); DISPATCH(); } while (0)
+#define BRANCH(condition) do { if (condition) { JUMP(program[index].target); } NEXT(); } while (0)
+#define SIMPLE(name) op_##name: execute<Opcode::name>(program[index], *global_state); NEXT();
+// pc is only kept where a memory fault needs it
+#define MEMORY(name) op_##name: registers[pc] = index * INSTRUCTION_SIZE; std::atomic_signal_fence(std::memory_order_seq_cst); execute<Opcode::name>(program[index], *global_state); NEXT();
+#define STORE(name) op_##name: registers[pc] = index * INSTRUCTION_SIZE; std::atomic_signal_fence(std::memory_order_seq_cst); execute<Opcode::name>(program[index], *global_state); \
+    if (global_state->code_written) { ++index; goto stale; } NEXT();
+
+dispatch_pc:
+    // pc was set by the state (entry, ret or a write to the pc register)
+    if ((unsigned long) registers[pc] >= size * INSTRUCTION_SIZE) {
+        retired += executed;
+        removed_dispatches += removed;
+        return;
+    }
+    if (registers[pc] % INSTRUCTION_SIZE != 0) {
+        retired += executed;
+        removed_dispatches += removed;
+        throw RuntimeException("Wrong pc: " + std::to_string(registers[pc]));
+    }
+    index = registers[pc] / INSTRUCTION_SIZE;
+    goto *code[index];
+
+    SIMPLE(Add)
+    SIMPLE(Li)
+    SIMPLE(Addi)
+    SIMPLE(And)
+    SIMPLE(Mv)
+    SIMPLE(Or)
+    SIMPLE(SLL)
+    SIMPLE(SLLI)
+    SIMPLE(SRL)
+    SIMPLE(SRLI)
+    SIMPLE(Sub)
+    SIMPLE(Xor)
+    STORE(Sb)
+    STORE(Sh)
+    STORE(Sw)
+    MEMORY(Lw)
+    MEMORY(Lh)
+    MEMORY(Lb)
+    SIMPLE(La)
+    SIMPLE(EBreak)
+    SIMPLE(Data)
+    SIMPLE(Trap)
+
+op_Stale:
+op_Unparsed:
+    // never in code[], which is built before anything is written or once every line is parsed
+    --executed;
+stale:
+    retired += executed;
+    removed_dispatches += removed;
+    registers[pc] = index * INSTRUCTION_SIZE;
+    return;
+
+op_Ecall:
+    registers[pc] = index * INSTRUCTION_SIZE;
+    try {
+        execute<Opcode::Ecall>(program[index], *global_state);
+    } catch (const ExitException&) {
+        // the exit ecall retired as well, the next dispatch would have counted it
+        retired += executed + 1;
+        removed_dispatches += removed;
+        throw;
+    }
+    NEXT();
+op_Jump:
+    JUMP(program[index].target);
+op_Call:
+    registers[ra] = index * INSTRUCTION_SIZE;
+    JUMP(program[index].target);
+op_JumpAndLink:
+    registers[program[index].rd] = index * INSTRUCTION_SIZE;
+    JUMP(program[index].target);
+op_BranchEqual:
+    BRANCH(registers[program[index].rs1] == registers[program[index].rs2]);
+op_BranchEqualZero:
+    BRANCH(registers[program[index].rs1] == 0);
+op_BranchNotEqual:
+    BRANCH(registers[program[index].rs1] != registers[program[index].rs2]);
+op_BranchLessThen:
+    BRANCH(registers[program[index].rs1] < registers[program[index].rs2]);
+op_BranchGreaterEqual:
+    BRANCH(registers[program[index].rs1] >= registers[program[index].rs2]);
+op_BranchGreaterThen:
+    BRANCH(registers[program[index].rs1] > registers[program[index].rs2]);
+op_Return:
+    registers[pc] = registers[ra] + INSTRUCTION_SIZE;
+    ++executed;
+    goto dispatch_pc;
+
+generic:
+    registers[pc] = index * INSTRUCTION_SIZE;
+    execute_fused(&program[index], *global_state);
+    registers[pc] += INSTRUCTION_SIZE;
+    ++executed;
+    goto dispatch_pc;
+
+#define FUSED(name, first, rest)                                \
+op_##name:                                                      \
+    if constexpr (accesses_memory(Opcode::first)) {             \
+        registers[pc] = index * INSTRUCTION_SIZE;               \
+        std::atomic_signal_fence(std::memory_order_seq_cst);    \
+    }                                                           \
+    execute<Opcode::first>(program[index], *global_state);      \
+    ++index;                                                    \
+    ++executed;                                                 \
+    ++removed;                                                  \
+    goto op_##rest;
+    FUSED_LIST(FUSED)
+#undef FUSED
+
+halt:
+    retired += executed;
+    removed_dispatches += removed;
+    registers[pc] = size * INSTRUCTION_SIZE;
+
+#undef STORE
+#undef MEMORY
+#undef SIMPLE
+#undef BRANCH
+#undef JUMP
+#undef NEXT
+#undef DISPATCH
+}
+
+#else
+
+void Interpreter::interpret_threaded() {
+    interpret_switch<false>();
+}
+
+#endif
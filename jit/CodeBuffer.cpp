@@ -0,0 +1,35 @@
+#include "CodeBuffer.hpp"
+
+#include <cstring>
+#include <sys/mman.h>
+
+void* CodeBuffer::commit(const std::vector<unsigned char>& code) {
+    if (code.size() > CHUNK_SIZE) {
+        return nullptr;
+    }
+    if (chunks.empty() || chunks.back().used + code.size() > CHUNK_SIZE) {
+        void* memory = mmap(nullptr, CHUNK_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        chunks.push_back({static_cast<unsigned char*>(memory), 0});
+    }
+    Chunk& chunk = chunks.back();
+    if (mprotect(chunk.memory, CHUNK_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+    unsigned char* start = chunk.memory + chunk.used;
+    std::memcpy(start, code.data(), code.size());
+    // keep entries 16-byte aligned
+    chunk.used = (chunk.used + code.size() + 15) & ~(size_t) 15;
+    if (mprotect(chunk.memory, CHUNK_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        return nullptr;
+    }
+    return start;
+}
+
+CodeBuffer::~CodeBuffer() {
+    for (const Chunk& chunk : chunks) {
+        munmap(chunk.memory, CHUNK_SIZE);
+    }
+}
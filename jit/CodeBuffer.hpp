@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/*  Executable memory for generated code, mmap'd in chunks.
+    A chunk is writable only while code is copied into it (W^X),
+    nothing is freed before the buffer is destroyed. */
+class CodeBuffer {
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+    struct Chunk {
+        unsigned char* memory;
+        size_t used;
+    };
+    std::vector<Chunk> chunks;
+
+   public:
+    CodeBuffer() = default;
+    CodeBuffer(const CodeBuffer&) = delete;
+    CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+    // copies code into executable memory, nullptr if the system refuses to map any
+    void* commit(const std::vector<unsigned char>& code);
+
+    ~CodeBuffer();
+};
@@ -0,0 +1,420 @@
+#include "Jit.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "../consts.hpp"
+#include "../memory/Memory.hpp"
+#include "X86Assembler.hpp"
+
+bool Jit::supported() {
+#if defined(__x86_64__)
+    return true;
+#else
+    return false;
+#endif
+}
+
+namespace {
+
+// rdi = registers, rsi = guest address 0 of Memory, indexed with checked addresses, rdx = executed, r11 counts retired instructions,
+// rax and rcx are scratch; guest registers get the rest
+constexpr std::array<HostRegister, 9> ALLOCATABLE = {r8, r9, r10, rbx, rbp, r12, r13, r14, r15};
+
+bool callee_saved(HostRegister reg) {
+    return reg == rbx || reg == rbp || reg >= r12;
+}
+
+// operands the parser leaves at zero are not counted, they would take a host register for nothing
+bool writes_rd(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::Sb: case Opcode::Sh: case Opcode::Sw: case Opcode::EBreak:
+        case Opcode::Jump: case Opcode::Call: case Opcode::Return:
+        case Opcode::BranchEqual: case Opcode::BranchEqualZero: case Opcode::BranchNotEqual:
+        case Opcode::BranchLessThen: case Opcode::BranchGreaterEqual: case Opcode::BranchGreaterThen:
+            return false;
+        default:
+            return true;
+    }
+}
+
+bool reads_rs1(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::Li: case Opcode::La: case Opcode::EBreak:
+        case Opcode::Jump: case Opcode::Call: case Opcode::JumpAndLink: case Opcode::Return:
+            return false;
+        default:
+            return true;
+    }
+}
+
+bool reads_rs2(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::Add: case Opcode::And: case Opcode::Or: case Opcode::SLL: case Opcode::SRL:
+        case Opcode::Sub: case Opcode::Xor: case Opcode::Sb: case Opcode::Sh: case Opcode::Sw:
+        case Opcode::BranchEqual: case Opcode::BranchNotEqual: case Opcode::BranchLessThen:
+        case Opcode::BranchGreaterEqual: case Opcode::BranchGreaterThen:
+            return true;
+        default:
+            return false;
+    }
+}
+
+class BlockCompiler {
+    const BasicBlock& block;
+    const std::vector<DecodedInstruction>& program;
+    const CodeRegion& code_region;
+    X86Assembler a;
+
+    std::array<int, AMOUNT_REGISTERS> host;     // host register of a guest register, -1 if in memory
+    std::array<bool, AMOUNT_REGISTERS> dirty{};
+    std::vector<HostRegister> saved;
+    size_t loop_head = 0;
+
+    static int32_t slot(Register reg) { return reg * (int32_t) sizeof(long); }
+
+    HostRegister read(Register reg, HostRegister scratch) {
+        if (host[reg] >= 0) {
+            return (HostRegister) host[reg];
+        }
+        a.load(scratch, rdi, slot(reg));
+        return scratch;
+    }
+
+    HostRegister destination(Register reg) {
+        return host[reg] >= 0 ? (HostRegister) host[reg] : rax;
+    }
+
+    void written(Register reg, HostRegister value) {
+        if (host[reg] < 0) {
+            a.store(rdi, slot(reg), value);
+        }
+    }
+
+    void copy(HostRegister destination, HostRegister source) {
+        if (destination != source) {
+            a.mov(destination, source);
+        }
+    }
+
+    // Memory::offset() of the address in address: with any of the upper 32 bits set it calls
+    // Memory::fault(), which does not return, so the stack only has to be aligned for it
+    void check_address(HostRegister address, HostRegister scratch) {
+        a.mov(scratch, address);
+        a.shift_immediate(X86Assembler::Shr, scratch, 32);
+        size_t inside = a.jump_if(Condition::Equal);
+        a.mov(rdi, address);
+        a.alu_immediate(X86Assembler::And, rsp, -16);
+        a.mov_immediate(rax, reinterpret_cast<long>(&Memory::fault));
+        a.call(rax);
+        a.patch(inside, a.position());
+    }
+
+    // rax holds the pc to continue at
+    void leave(size_t retired) {
+        a.alu_immediate(X86Assembler::Add, r11, retired);
+        a.add_to_memory(rdx, 0, r11);
+        for (int reg = 0; reg < AMOUNT_REGISTERS; reg++) {
+            if (dirty[reg] && host[reg] >= 0) {
+                a.store(rdi, slot((Register) reg), (HostRegister) host[reg]);
+            }
+        }
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            a.pop(*it);
+        }
+        a.ret();
+    }
+
+    void continue_at(size_t index) {
+        if (index == block.start) {
+            a.alu_immediate(X86Assembler::Add, r11, block.length);
+            a.patch(a.jump(), loop_head);
+        } else {
+            a.mov_immediate(rax, index * INSTRUCTION_SIZE);
+            leave(block.length);
+        }
+    }
+
+    void allocate(size_t from, size_t to) {
+        std::array<int, AMOUNT_REGISTERS> uses{};
+        for (size_t i = from; i < to; i++) {
+            const DecodedInstruction& instruction = program[i];
+            if (writes_rd(instruction.opcode) && instruction.rd != zero_sink) {
+                ++uses[instruction.rd];
+                dirty[instruction.rd] = true;
+            }
+            if (reads_rs2(instruction.opcode)) {
+                ++uses[instruction.rs2];
+            }
+            if (reads_rs1(instruction.opcode)) {
+                ++uses[instruction.rs1];
+            }
+        }
+        // call writes ra and ret reads it, neither names it as an operand
+        if (program[to - 1].opcode == Opcode::Call || program[to - 1].opcode == Opcode::Return) {
+            ++uses[ra];
+            dirty[ra] |= program[to - 1].opcode == Opcode::Call;
+        }
+        std::array<int, AMOUNT_REGISTERS> order;
+        for (int reg = 0; reg < AMOUNT_REGISTERS; reg++) {
+            order[reg] = reg;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](int x, int y) { return uses[x] > uses[y]; });
+        host.fill(-1);
+        for (size_t i = 0; i < ALLOCATABLE.size() && uses[order[i]] > 0; i++) {
+            host[order[i]] = ALLOCATABLE[i];
+        }
+    }
+
+    bool body(const DecodedInstruction& instruction, size_t index);
+    void alu(X86Assembler::AluOp op, const DecodedInstruction& instruction);
+    void shift(X86Assembler::ShiftOp op, const DecodedInstruction& instruction, bool immediate);
+    void exit(const DecodedInstruction& instruction, size_t index);
+
+   public:
+    BlockCompiler(const BasicBlock& block_, const std::vector<DecodedInstruction>& program_, const CodeRegion& code_region_)
+        : block(block_), program(program_), code_region(code_region_) {}
+
+    bool compile(bool& native_exit);
+    const std::vector<unsigned char>& code() const { return a.bytes(); }
+};
+
+void BlockCompiler::alu(X86Assembler::AluOp op, const DecodedInstruction& instruction) {
+    HostRegister second = read(instruction.rs2, rcx);
+    HostRegister first = read(instruction.rs1, rax);
+    HostRegister result = destination(instruction.rd);
+    if (result == first) {
+        a.alu(op, result, second);
+    } else if (result != second) {
+        a.mov(result, first);
+        a.alu(op, result, second);
+    } else {
+        copy(rax, first);
+        a.alu(op, rax, second);
+        a.mov(result, rax);
+    }
+    written(instruction.rd, result);
+}
+
+void BlockCompiler::shift(X86Assembler::ShiftOp op, const DecodedInstruction& instruction, bool immediate) {
+    // the host masks the amount to 6 bits, like the shifts the interpreter is compiled to
+    if (!immediate) {
+        copy(rcx, read(instruction.rs2, rcx));
+    }
+    HostRegister result = destination(instruction.rd);
+    copy(result, read(instruction.rs1, rax));
+    if (immediate) {
+        a.shift_immediate(op, result, instruction.immediate & 63);
+    } else {
+        a.shift_cl(op, result);
+    }
+    written(instruction.rd, result);
+}
+
+bool BlockCompiler::body(const DecodedInstruction& instruction, size_t index) {
+    const Register rd = instruction.rd;
+    // only results for zero are decoded to the sink, dropping them is all they do
+    if (rd == zero_sink) {
+        return true;
+    }
+
+    switch (instruction.opcode) {
+        case Opcode::Add: alu(X86Assembler::Add, instruction); return true;
+        case Opcode::Sub: alu(X86Assembler::Sub, instruction); return true;
+        case Opcode::And: alu(X86Assembler::And, instruction); return true;
+        case Opcode::Or: alu(X86Assembler::Or, instruction); return true;
+        case Opcode::Xor: alu(X86Assembler::Xor, instruction); return true;
+        case Opcode::SLL: shift(X86Assembler::Shl, instruction, false); return true;
+        case Opcode::SLLI: shift(X86Assembler::Shl, instruction, true); return true;
+        // the interpreter shifts a signed long
+        case Opcode::SRL: shift(X86Assembler::Sar, instruction, false); return true;
+        case Opcode::SRLI: shift(X86Assembler::Sar, instruction, true); return true;
+        case Opcode::Li: {
+            HostRegister result = destination(rd);
+            a.mov_immediate(result, instruction.immediate);
+            written(rd, result);
+            return true;
+        }
+        case Opcode::La: {
+            HostRegister result = destination(rd);
+            a.mov_immediate(result, instruction.target * INSTRUCTION_SIZE);
+            written(rd, result);
+            return true;
+        }
+        case Opcode::Mv: {
+            HostRegister result = destination(rd);
+            copy(result, read(instruction.rs1, rax));
+            written(rd, result);
+            return true;
+        }
+        case Opcode::Addi: {
+            HostRegister result = destination(rd);
+            copy(result, read(instruction.rs1, rax));
+            if (X86Assembler::fits_int32(instruction.immediate)) {
+                a.alu_immediate(X86Assembler::Add, result, instruction.immediate);
+            } else {
+                a.mov_immediate(rcx, instruction.immediate);
+                a.alu(X86Assembler::Add, result, rcx);
+            }
+            written(rd, result);
+            return true;
+        }
+        case Opcode::Lw: case Opcode::Lh: case Opcode::Lb: {
+            if (!X86Assembler::fits_int32(instruction.immediate)) {
+                return false;
+            }
+            int size = instruction.opcode == Opcode::Lw ? 8 : instruction.opcode == Opcode::Lh ? 4 : 1;
+            // for the report of a fault in the guard region
+            a.store_immediate(rdi, slot(pc), index * INSTRUCTION_SIZE);
+            HostRegister address = read(instruction.rs1, rcx);
+            a.lea(rcx, address, instruction.immediate);
+            check_address(rcx, rax);
+            HostRegister result = destination(rd);
+            a.load_indexed(size, result, rsi, rcx, 0);
+            written(rd, result);
+            return true;
+        }
+        case Opcode::Sw: case Opcode::Sh: case Opcode::Sb: {
+            if (!X86Assembler::fits_int32(instruction.immediate)) {
+                return false;
+            }
+            int size = instruction.opcode == Opcode::Sw ? 8 : instruction.opcode == Opcode::Sh ? 4 : 1;
+            // CodeRegion::overlaps() on the checked address in rax, a hit leaves with pc at the store
+            const long bias = size - 1 - code_region.start;
+            const long limit = code_region.size + size - 1;
+            if (!X86Assembler::fits_int32(bias) || !X86Assembler::fits_int32(limit)) {
+                return false;
+            }
+            a.store_immediate(rdi, slot(pc), index * INSTRUCTION_SIZE);
+            HostRegister address = read(instruction.rs1, rax);
+            a.lea(rax, address, instruction.immediate);
+            check_address(rax, rcx);
+            a.mov(rcx, rax);
+            a.alu_immediate(X86Assembler::Add, rcx, bias);
+            a.alu_immediate(X86Assembler::Cmp, rcx, limit);
+            size_t outside = a.jump_if(Condition::AboveEqual);
+            a.mov_immediate(rax, index * INSTRUCTION_SIZE);
+            leave(index - block.start);
+            a.patch(outside, a.position());
+            HostRegister value = read(instruction.rs2, rcx);
+            a.store_indexed(size, rsi, rax, 0, value);
+            return true;
+        }
+        case Opcode::EBreak:
+            return true;
+        default:
+            return false;
+    }
+}
+
+Condition branch_condition(Opcode opcode) {
+    switch (opcode) {
+        case Opcode::BranchEqual: case Opcode::BranchEqualZero: return Condition::Equal;
+        case Opcode::BranchNotEqual: return Condition::NotEqual;
+        case Opcode::BranchLessThen: return Condition::Less;
+        case Opcode::BranchGreaterEqual: return Condition::GreaterEqual;
+        default: return Condition::Greater;
+    }
+}
+
+void BlockCompiler::exit(const DecodedInstruction& instruction, size_t index) {
+    switch (instruction.opcode) {
+        case Opcode::Jump:
+            continue_at(instruction.target);
+            return;
+        case Opcode::Call:
+        case Opcode::JumpAndLink: {
+            Register link = instruction.opcode == Opcode::Call ? ra : instruction.rd;
+            HostRegister result = destination(link);
+            a.mov_immediate(result, index * INSTRUCTION_SIZE);
+            written(link, result);
+            dirty[link] = true;
+            continue_at(instruction.target);
+            return;
+        }
+        case Opcode::Return:
+            copy(rax, read(ra, rax));
+            a.alu_immediate(X86Assembler::Add, rax, INSTRUCTION_SIZE);
+            leave(block.length);
+            return;
+        case Opcode::BranchEqualZero: {
+            HostRegister value = read(instruction.rs1, rax);
+            a.test(value, value);
+            break;
+        }
+        default: {
+            HostRegister second = read(instruction.rs2, rcx);
+            HostRegister first = read(instruction.rs1, rax);
+            a.alu(X86Assembler::Cmp, first, second);
+            break;
+        }
+    }
+    size_t taken = a.jump_if(branch_condition(instruction.opcode));
+    continue_at(block.end);
+    a.patch(taken, a.position());
+    continue_at(instruction.target);
+}
+
+bool BlockCompiler::compile(bool& native_exit) {
+    const size_t control = block.end - 1;
+    native_exit = block.exit != nullptr && is_control(program[control].opcode);
+    size_t body_end = block.end;
+    if (native_exit) {
+        body_end = control;
+    } else if (block.exit != nullptr) {
+        body_end = block.exit_index;
+    }
+    if (body_end == block.start && !native_exit) {
+        return false;
+    }
+
+    allocate(block.start, native_exit ? block.end : body_end);
+    for (HostRegister reg : ALLOCATABLE) {
+        bool used = std::find(host.begin(), host.end(), reg) != host.end();
+        if (used && callee_saved(reg)) {
+            a.push(reg);
+            saved.push_back(reg);
+        }
+    }
+    a.mov_immediate(r11, 0);
+    for (int reg = 0; reg < AMOUNT_REGISTERS; reg++) {
+        if (host[reg] >= 0) {
+            a.load((HostRegister) host[reg], rdi, slot((Register) reg));
+        }
+    }
+    loop_head = a.position();
+
+    for (size_t i = block.start; i < body_end; i++) {
+        if (!body(program[i], i)) {
+            return false;
+        }
+    }
+    if (native_exit) {
+        exit(program[control], control);
+    } else {
+        // the interpreter continues with the exit, or the next block
+        size_t next = block.exit == nullptr ? block.end : block.exit_index;
+        a.mov_immediate(rax, next * INSTRUCTION_SIZE);
+        leave(next - block.start);
+    }
+    return true;
+}
+
+}  // namespace
+
+NativeBlock Jit::compile(const BasicBlock& block, const std::vector<DecodedInstruction>& instructions, const CodeRegion& code_region,
+                         bool& native_exit) {
+    if (!supported()) {
+        return nullptr;
+    }
+    BlockCompiler compiler(block, instructions, code_region);
+    if (!compiler.compile(native_exit)) {
+        return nullptr;
+    }
+    void* code = buffer.commit(compiler.code());
+    if (code == nullptr) {
+        return nullptr;
+    }
+    ++compiled;
+    return reinterpret_cast<NativeBlock>(code);
+}
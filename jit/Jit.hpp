@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+#include "../interpreter/BasicBlock.hpp"
+#include "CodeBuffer.hpp"
+
+/*  Translates hot basic blocks into x86-64 code.
+    Guest registers used by a block live in host registers while it runs and are
+    written back on exit, a branch back to the start of the block loops natively.
+    Blocks with instructions the JIT does not know stay interpreted, as does an
+    ecall or pc exit, which the interpreter runs after the native body.
+    A store into code returns before it with pc at the store, for the interpreter
+    to run it and mark the decode cache. */
+class Jit {
+    CodeBuffer buffer;
+    unsigned long compiled = 0;
+
+   public:
+    // instructions are the parsed program, without superinstructions
+    NativeBlock compile(const BasicBlock& block, const std::vector<DecodedInstruction>& instructions, const CodeRegion& code_region,
+                        bool& native_exit);
+
+    unsigned long get_compiled() const { return compiled; }
+
+    // false when generated code can not run on this machine
+    static bool supported();
+};
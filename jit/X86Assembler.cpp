@@ -0,0 +1,183 @@
+#include "X86Assembler.hpp"
+
+void X86Assembler::int32(int32_t value) {
+    for (int i = 0; i < 4; i++) {
+        byte((value >> (i * 8)) & 0xFF);
+    }
+}
+
+void X86Assembler::int64(int64_t value) {
+    for (int i = 0; i < 8; i++) {
+        byte((value >> (i * 8)) & 0xFF);
+    }
+}
+
+// force emits an empty prefix, byte operations need it to reach sil/dil instead of dh/bh
+void X86Assembler::rex(bool wide, unsigned reg, unsigned index, unsigned base, bool force) {
+    unsigned char prefix = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+    if (prefix != 0x40 || force) {
+        byte(prefix);
+    }
+}
+
+void X86Assembler::modrm_register(unsigned reg, unsigned rm) {
+    byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void X86Assembler::modrm_memory(unsigned reg, HostRegister base, int32_t displacement) {
+    byte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == rsp) {
+        byte(0x24);
+    }
+    int32(displacement);
+}
+
+void X86Assembler::modrm_indexed(unsigned reg, HostRegister base, HostRegister index, int32_t displacement) {
+    byte(0x80 | ((reg & 7) << 3) | 4);
+    byte(((index & 7) << 3) | (base & 7));
+    int32(displacement);
+}
+
+void X86Assembler::mov(HostRegister destination, HostRegister source) {
+    rex(true, source, 0, destination);
+    byte(0x89);
+    modrm_register(source, destination);
+}
+
+void X86Assembler::mov_immediate(HostRegister destination, long value) {
+    if (fits_int32(value)) {
+        rex(true, 0, 0, destination);
+        byte(0xC7);
+        modrm_register(0, destination);
+        int32(value);
+    } else if (value == (long) (uint32_t) value) {
+        // a 32-bit move clears the upper half
+        rex(false, 0, 0, destination);
+        byte(0xB8 + (destination & 7));
+        int32(value);
+    } else {
+        rex(true, 0, 0, destination);
+        byte(0xB8 + (destination & 7));
+        int64(value);
+    }
+}
+
+void X86Assembler::load(HostRegister destination, HostRegister base, int32_t displacement) {
+    rex(true, destination, 0, base);
+    byte(0x8B);
+    modrm_memory(destination, base, displacement);
+}
+
+void X86Assembler::store(HostRegister base, int32_t displacement, HostRegister source) {
+    rex(true, source, 0, base);
+    byte(0x89);
+    modrm_memory(source, base, displacement);
+}
+
+// sign-extended to 64 bits
+void X86Assembler::store_immediate(HostRegister base, int32_t displacement, int32_t value) {
+    rex(true, 0, 0, base);
+    byte(0xC7);
+    modrm_memory(0, base, displacement);
+    int32(value);
+}
+
+void X86Assembler::lea(HostRegister destination, HostRegister base, int32_t displacement) {
+    rex(true, destination, 0, base);
+    byte(0x8D);
+    modrm_memory(destination, base, displacement);
+}
+
+void X86Assembler::load_indexed(int size, HostRegister destination, HostRegister base, HostRegister index, int32_t displacement) {
+    rex(size == 8, destination, index, base);
+    if (size == 1) {
+        byte(0x0F);
+        byte(0xB6);
+    } else {
+        byte(0x8B);
+    }
+    modrm_indexed(destination, base, index, displacement);
+}
+
+void X86Assembler::store_indexed(int size, HostRegister base, HostRegister index, int32_t displacement, HostRegister source) {
+    rex(size == 8, source, index, base, size == 1 && source >= rsp);
+    byte(size == 1 ? 0x88 : 0x89);
+    modrm_indexed(source, base, index, displacement);
+}
+
+void X86Assembler::alu(AluOp op, HostRegister destination, HostRegister source) {
+    rex(true, source, 0, destination);
+    byte(op);
+    modrm_register(source, destination);
+}
+
+void X86Assembler::alu_immediate(AluOp op, HostRegister destination, int32_t value) {
+    // the /digit of the immediate form is bits 3..5 of the register form opcode
+    rex(true, 0, 0, destination);
+    byte(0x81);
+    modrm_register(op >> 3, destination);
+    int32(value);
+}
+
+void X86Assembler::add_to_memory(HostRegister base, int32_t displacement, HostRegister source) {
+    rex(true, source, 0, base);
+    byte(0x01);
+    modrm_memory(source, base, displacement);
+}
+
+void X86Assembler::shift_cl(ShiftOp op, HostRegister destination) {
+    rex(true, 0, 0, destination);
+    byte(0xD3);
+    modrm_register(op, destination);
+}
+
+void X86Assembler::shift_immediate(ShiftOp op, HostRegister destination, unsigned char amount) {
+    rex(true, 0, 0, destination);
+    byte(0xC1);
+    modrm_register(op, destination);
+    byte(amount);
+}
+
+void X86Assembler::test(HostRegister first, HostRegister second) {
+    rex(true, second, 0, first);
+    byte(0x85);
+    modrm_register(second, first);
+}
+
+void X86Assembler::push(HostRegister reg) {
+    rex(false, 0, 0, reg);
+    byte(0x50 + (reg & 7));
+}
+
+void X86Assembler::pop(HostRegister reg) {
+    rex(false, 0, 0, reg);
+    byte(0x58 + (reg & 7));
+}
+
+void X86Assembler::call(HostRegister target) {
+    rex(false, 0, 0, target);
+    byte(0xFF);
+    modrm_register(2, target);
+}
+
+size_t X86Assembler::jump() {
+    byte(0xE9);
+    size_t field = position();
+    int32(0);
+    return field;
+}
+
+size_t X86Assembler::jump_if(Condition condition) {
+    byte(0x0F);
+    byte(0x80 | static_cast<unsigned char>(condition));
+    size_t field = position();
+    int32(0);
+    return field;
+}
+
+void X86Assembler::patch(size_t field, size_t target) {
+    int32_t relative = (int32_t) (target - (field + 4));
+    for (int i = 0; i < 4; i++) {
+        code[field + i] = (relative >> (i * 8)) & 0xFF;
+    }
+}
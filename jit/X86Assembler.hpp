@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// x86-64 general purpose registers in encoding order
+enum HostRegister : unsigned char {
+    rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+// condition codes of jcc, signed comparisons and the unsigned one of a range check
+enum class Condition : unsigned char {
+    AboveEqual = 0x3, Equal = 0x4, NotEqual = 0x5, Less = 0xC, GreaterEqual = 0xD, Greater = 0xF
+};
+
+/*  Emits the few 64-bit x86 instructions the JIT needs into a byte vector.
+    Memory operands are always [base + disp32] or [base + index + disp32],
+    so rbp and r13 need no special casing; rsp and r12 as a base get a SIB byte. */
+class X86Assembler {
+    std::vector<unsigned char> code;
+
+    void byte(unsigned char value) { code.push_back(value); }
+    void int32(int32_t value);
+    void int64(int64_t value);
+
+    void rex(bool wide, unsigned reg, unsigned index, unsigned base, bool force = false);
+    void modrm_register(unsigned reg, unsigned rm);
+    void modrm_memory(unsigned reg, HostRegister base, int32_t displacement);
+    void modrm_indexed(unsigned reg, HostRegister base, HostRegister index, int32_t displacement);
+
+   public:
+    // ALU opcodes of the "op r/m64, r64" form
+    enum AluOp : unsigned char { Add = 0x01, Or = 0x09, And = 0x21, Sub = 0x29, Xor = 0x31, Cmp = 0x39 };
+    // /digit of the shift group
+    enum ShiftOp : unsigned char { Shl = 4, Shr = 5, Sar = 7 };
+
+    static bool fits_int32(long value) { return value == (int32_t) value; }
+
+    void mov(HostRegister destination, HostRegister source);
+    void mov_immediate(HostRegister destination, long value);
+    void load(HostRegister destination, HostRegister base, int32_t displacement);
+    void store(HostRegister base, int32_t displacement, HostRegister source);
+    void store_immediate(HostRegister base, int32_t displacement, int32_t value);
+    // destination = base + displacement
+    void lea(HostRegister destination, HostRegister base, int32_t displacement);
+
+    // zero-extending loads and truncating stores of 1, 4 or 8 bytes at [base + index + displacement]
+    void load_indexed(int size, HostRegister destination, HostRegister base, HostRegister index, int32_t displacement);
+    void store_indexed(int size, HostRegister base, HostRegister index, int32_t displacement, HostRegister source);
+
+    void alu(AluOp op, HostRegister destination, HostRegister source);
+    void alu_immediate(AluOp op, HostRegister destination, int32_t value);
+    void add_to_memory(HostRegister base, int32_t displacement, HostRegister source);
+    void shift_cl(ShiftOp op, HostRegister destination);
+    void shift_immediate(ShiftOp op, HostRegister destination, unsigned char amount);
+    void test(HostRegister first, HostRegister second);
+
+    void push(HostRegister reg);
+    void pop(HostRegister reg);
+    void ret() { byte(0xC3); }
+    void call(HostRegister target);
+
+    // jumps return the offset of their rel32 field, see patch()
+    size_t jump();
+    size_t jump_if(Condition condition);
+    size_t position() const { return code.size(); }
+    void patch(size_t field, size_t target);
+
+    const std::vector<unsigned char>& bytes() const { return code; }
+};
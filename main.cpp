@@ -1,15 +1,22 @@
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/screen/screen.hpp>
+#include <chrono>
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
 #include "interpreter/Interpreter.hpp"
+#include "exceptions/ExitException.hpp"
+#include "exceptions/LoaderException.hpp"
 #include "exceptions/ParserException.hpp"
 #include "exceptions/PreprocessorException.hpp"
 #include "exceptions/RuntimeException.hpp"
+#include "frontend/ElfLoader.hpp"
+#include "frontend/ElfWriter.hpp"
 #include "frontend/Parser.hpp"
 #include "frontend/Preprocessor.hpp"
+#include "frontend/ProgramCache.hpp"
+#include "frontend/Reassembler.hpp"
 #include "instructions/Instruction.hpp"
-#include "tests/simple_instructions_test.hpp"
 #include "UI/UI.hpp"
 
 
@@ -18,50 +25,210 @@ int main(int argc, char *argv[]) {
   string file;
   bool debug_mode = false;
   bool graph_mode = false;
+  bool stats_mode = false;
+  bool fusion = true;
+  bool lazy = false;
+  bool validate = false;
+  bool watch = false;
+  string aot_path;
+  string cache_dir;
+  string emit_path;
+  long block_threshold = -1;
+  long jit_threshold = -1;
+  unsigned long memory_size = DEFAULT_MEMORY_SIZE;
+  Engine engine = Engine::Switch;
 
   if (argc > 1) {
     file = argv[1];
-    if ((argc > 2) ) {
-      if (strcmp(argv[2], "-g") == 0) {
+    for (int i = 2; i < argc; i++) {
+      if (strcmp(argv[i], "-g") == 0) {
         debug_mode = true;
         graph_mode = true;
       }
-      else if (strcmp(argv[2], "-d") == 0) {
+      else if (strcmp(argv[i], "-d") == 0) {
         debug_mode = true;
       }
+      else if (strcmp(argv[i], "--stats") == 0) {
+        stats_mode = true;
+      }
+      else if (strcmp(argv[i], "--no-fusion") == 0) {
+        fusion = false;
+      }
+      else if (strcmp(argv[i], "--lazy") == 0) {
+        lazy = true;
+      }
+      else if (strcmp(argv[i], "--validate") == 0) {
+        validate = true;
+      }
+      else if (strcmp(argv[i], "--watch") == 0) {
+        watch = true;
+      }
+      else if (strcmp(argv[i], "--aot") == 0 && i + 1 < argc) {
+        aot_path = argv[++i];
+      }
+      else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+        cache_dir = argv[++i];
+      }
+      else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+        emit_path = argv[++i];
+      }
+      else if (strcmp(argv[i], "--block-threshold") == 0 && i + 1 < argc) {
+        block_threshold = strtol(argv[++i], nullptr, 10);
+      }
+      else if (strcmp(argv[i], "--jit-threshold") == 0 && i + 1 < argc) {
+        jit_threshold = strtol(argv[++i], nullptr, 10);
+      }
+      else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+        // bytes, with an optional K, M or G suffix
+        char* suffix = nullptr;
+        memory_size = strtoul(argv[++i], &suffix, 10);
+        if (*suffix == 'K' || *suffix == 'k') {
+          memory_size <<= 10;
+        } else if (*suffix == 'M' || *suffix == 'm') {
+          memory_size <<= 20;
+        } else if (*suffix == 'G' || *suffix == 'g') {
+          memory_size <<= 30;
+        }
+        // guest addresses are 32 bits wide
+        if (memory_size > Memory::ADDRESS_SPACE) {
+          cout << "Memory size is limited to 4G" << endl;
+          exit(1);
+        }
+      }
+      else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+        i++;
+        if (strcmp(argv[i], "switch") == 0) {
+          engine = Engine::Switch;
+        } else if (strcmp(argv[i], "threaded") == 0) {
+          engine = Engine::Threaded;
+        } else if (strcmp(argv[i], "blocks") == 0) {
+          engine = Engine::Blocks;
+        } else if (strcmp(argv[i], "jit") == 0) {
+          engine = Engine::Jit;
+        } else if (strcmp(argv[i], "tiered") == 0) {
+          engine = Engine::Tiered;
+        } else {
+          cout << "Unknown engine: " << argv[i] << " (switch, threaded, blocks, jit, tiered)" << endl;
+          exit(1);
+        }
+      }
     }
   } else {
     cout << "No incoming file" << endl;
     exit(1);
   }
+  // an emitted or checked program needs every line parsed
+  lazy = lazy && emit_path.empty() && !validate;
 
-  Preprocessor preprocessor = Preprocessor(file);
+  vector<string> all_lines_in;
+  Program program;
+  // --lazy preprocesses and parses plain lines while the program runs, from the source lines
+  std::unique_ptr<Preprocessor> preprocessor;
+  std::unique_ptr<Parser> parser;
+  long entry = -1;
+  bool cache_hit = false;
+  if (is_elf_file(file)) {
+    // an executable skips the text frontend, a listing of its code stands in for the source
+    try {
+      program = load_elf(file, memory_size, all_lines_in, entry);
+    } catch (const LoaderException& e) {
+      cout << e.get_message() << endl;
+      exit(1);
+    }
+  } else {
+    preprocessor = std::make_unique<Preprocessor>(file, cache_dir);
+    all_lines_in = std::move(preprocessor->all_lines_in());
 
-  try {
-    preprocessor.preprocess();
-  } catch (const PreprocessorException& e) {
-    cout << e.get_message() << endl;
-    exit(1);
-  }
+    // a hit in the program cache skips preprocessing, lexing and parsing
+    cache_hit = !cache_dir.empty() && load_cached_program(cache_dir, all_lines_in, program);
+    if (!cache_hit) {
+      if (lazy) {
+        preprocessor->defer_plain_lines();
+      }
+      try {
+        preprocessor->preprocess();
+      } catch (const PreprocessorException& e) {
+        cout << e.get_message() << endl;
+        exit(1);
+      }
+      program.labels = std::move(preprocessor->get_labels());
+      program.from_in_to_inparse = std::move(preprocessor->get_from_in_to_inparse());
+      program.from_inparse_to_in = std::move(preprocessor->get_from_inparse_to_in());
+      program.includes = preprocessor->get_included();
 
-  Lexer lexer(preprocessor.get_inparse());
+      Lexer lexer(preprocessor->get_inparse());
 
-  Parser parser(lexer, preprocessor.get_labels(), preprocessor.get_from_inparse_to_in());
-  vector<Instruction*> instructions;
-  try {
-    instructions = parser.get_instructions();
-  } catch (const ParserException& e) {
-    cout << e.get_message() << endl;
-    exit(1);
+      parser = std::make_unique<Parser>(lexer, program.labels, program.from_inparse_to_in);
+      if (lazy) {
+        parser->set_source_lines(all_lines_in);
+      }
+      try {
+        program.instructions = lazy ? parser->get_lazy_program() : parser->get_program();
+      } catch (const ParserException& e) {
+        cout << e.get_message() << endl;
+        exit(1);
+      }
+      if (!cache_dir.empty() && !lazy) {
+        store_cached_program(cache_dir, all_lines_in, program);
+      }
+    }
+  }
+
+  // --validate only reports the first error of the program, which --lazy may never reach
+  if (validate) {
+    return 0;
   }
   
-  auto all_lines_in = preprocessor.all_lines_in();
-  
-  Interpreter controller(instructions, preprocessor.get_labels(), all_lines_in, preprocessor.get_from_in_to_inparse(), preprocessor.get_from_inparse_to_in(), debug_mode, graph_mode);
+  // --emit assembles instead of running: a flat image for .bin, an ELF executable otherwise
+  if (!emit_path.empty()) {
+    try {
+      if (emit_path.size() >= 4 && emit_path.compare(emit_path.size() - 4, 4, ".bin") == 0) {
+        write_flat_binary(emit_path, program);
+      } else {
+        write_elf(emit_path, program);
+      }
+    } catch (const EmitException& e) {
+      cout << e.get_message() << endl;
+      exit(1);
+    }
+    return 0;
+  }
+
+  Interpreter controller(std::move(program.instructions), program.labels, all_lines_in, program.from_in_to_inparse, program.from_inparse_to_in, debug_mode, graph_mode, memory_size, std::move(program.image));
+  if (entry >= 0) {
+    controller.get_state()->registers[pc] = entry;
+  }
+  if (lazy && parser != nullptr) {
+    controller.enable_lazy_parsing(std::move(parser));
+  }
+  if (preprocessor != nullptr) {
+    // a program from the cache was never preprocessed, its first reload is a full one
+    controller.enable_reload(std::make_unique<Reassembler>(file, cache_dir, cache_hit ? nullptr : std::move(preprocessor), program, all_lines_in), watch);
+  }
+  controller.set_engine(engine);
+  if (block_threshold >= 0) {
+    controller.set_block_threshold(block_threshold);
+  }
+  if (jit_threshold >= 0) {
+    controller.set_jit_threshold(jit_threshold);
+  }
+  if (fusion) {
+    controller.enable_fusion();
+  }
+  if (!aot_path.empty() && !debug_mode && !controller.enable_aot(aot_path)) {
+    cerr << "Running " << file << " without " << aot_path << endl;
+  }
+  // the code of an exit ecall, which ends the run from inside the engine
+  int exit_code = 0;
   if (graph_mode){
     UI ui(all_lines_in, debug_mode, controller);
-    ui.start();
+    try {
+      ui.start();
+    } catch (const ExitException& e) {
+      exit_code = e.get_code();
+    }
   } else {
+      auto start = chrono::steady_clock::now();
       try {
         if (debug_mode && controller.has_lines()) {
           controller.open_interface();
@@ -76,13 +243,42 @@ int main(int argc, char *argv[]) {
         if (debug_mode && controller.is_break()) {
           controller.open_interface();
         }
+      } catch (const ExitException& e) {
+        exit_code = e.get_code();
       } catch (const RuntimeException& e) {
         cout << e.get_message() << endl;
         exit(1);
       }
+      if (stats_mode) {
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        cerr << "retired instructions: " << controller.get_retired() << endl;
+        cerr << "time: " << elapsed.count() << " s" << endl;
+        cerr << "instructions per second: " << controller.get_retired() / elapsed.count() << endl;
+        cerr << "superinstructions: " << controller.get_fused_sites() << endl;
+        cerr << "dispatches removed: " << controller.get_removed_dispatches() << endl;
+        cerr << "memory pages: " << controller.get_resident_pages() << endl;
+        if (lazy) {
+          cerr << "unparsed lines: " << controller.get_unparsed() << endl;
+        }
+        if (engine == Engine::Blocks || engine == Engine::Jit || engine == Engine::Tiered) {
+          cerr << "basic blocks: " << controller.get_translated_blocks() << endl;
+        }
+        if (engine == Engine::Jit || engine == Engine::Tiered) {
+          cerr << "compiled blocks: " << controller.get_compiled_blocks() << endl;
+        }
+        if (engine == Engine::Tiered) {
+          cerr << "retired by tier (interpreter, blocks, native): " << controller.get_tier_retired(0) << ", "
+               << controller.get_tier_retired(1) << ", " << controller.get_tier_retired(2) << endl;
+        }
+        if (!cache_dir.empty()) {
+          cerr << "program cache: " << (cache_hit ? "hit in " : "miss in ") << cache_dir << endl;
+        }
+        if (!aot_path.empty()) {
+          cerr << "aot: " << (controller.aot_rebuilt() ? "built " : "loaded ") << aot_path << endl;
+        }
+      }
   }
 
   // preprocessor.dump_inparse();
-  // test_all();
-  return 0;
+  return exit_code;
 }
@@ -0,0 +1,82 @@
+#include "Memory.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <sys/mman.h>
+#include <vector>
+
+// the memory and recovery point of the innermost run_guarded()
+static Memory* guarded_memory = nullptr;
+static sigjmp_buf* guarded_recovery = nullptr;
+static struct sigaction previous_action;
+static bool handler_installed = false;
+
+// whole pages, the guard has to start right at the end of the guest range
+Memory::Memory(unsigned long size) : size_((std::min(size, ADDRESS_SPACE) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1)) {
+    const unsigned long reserved = size_ + GUARD_SIZE;
+    void* mapping = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    base = static_cast<std::byte*>(mapping);
+    if (size_ != 0 && mprotect(base, size_, PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, reserved);
+        throw std::bad_alloc();
+    }
+}
+
+Memory::~Memory() {
+    munmap(base, size_ + GUARD_SIZE);
+}
+
+unsigned long Memory::resident_pages() const {
+    std::vector<unsigned char> pages(size_ / PAGE_SIZE);
+    if (pages.empty() || mincore(base, size_, pages.data()) != 0) {
+        return 0;
+    }
+    unsigned long resident = 0;
+    for (unsigned char page : pages) {
+        resident += page & 1;
+    }
+    return resident;
+}
+
+void Memory::on_fault(int, siginfo_t* info, void*) {
+    Memory* memory = guarded_memory;
+    std::byte* address = static_cast<std::byte*>(info->si_addr);
+    if (memory != nullptr && address >= memory->base && address < memory->base + memory->size_ + GUARD_SIZE) {
+        memory->fault_address = address - memory->base;
+        siglongjmp(*guarded_recovery, 1);
+    }
+    // not a guest access: the faulting instruction runs again under the previous handler
+    sigaction(SIGSEGV, &previous_action, nullptr);
+    handler_installed = false;
+}
+
+void Memory::fault(long address) {
+    if (guarded_memory == nullptr) {
+        std::abort();
+    }
+    guarded_memory->fault_address = address;
+    siglongjmp(*guarded_recovery, 1);
+}
+
+Memory::Guard::Guard(Memory& memory, sigjmp_buf& recovery)
+    : previous_memory(guarded_memory), previous_recovery(guarded_recovery) {
+    if (!handler_installed) {
+        struct sigaction action = {};
+        action.sa_sigaction = on_fault;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previous_action);
+        handler_installed = true;
+    }
+    guarded_memory = &memory;
+    guarded_recovery = &recovery;
+}
+
+Memory::Guard::~Guard() {
+    guarded_memory = previous_memory;
+    guarded_recovery = previous_recovery;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <csetjmp>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+
+#include "../memory_access.hpp"
+
+/*  Guest memory, one anonymous mapping reserved without swap. The host pages
+    it: a page is allocated on the first store into it and reads as zeros
+    until then, so only touched memory costs anything.
+    Guest addresses are 32 bits wide: offset() faults on an address with any
+    of the upper 32 bits set, so a load or store reaches at most 4 GiB past
+    address 0. The guest range is followed by a PROT_NONE guard region that
+    covers the rest of that, so loads and stores are plain host moves after
+    that one test; an access that lands in the guard faults, and run_guarded()
+    turns either fault into a return. */
+class Memory {
+   public:
+    static constexpr unsigned long PAGE_SIZE = 4096;
+    static constexpr unsigned long ADDRESS_SPACE = 1UL << 32;
+    // any offset offset() gives and the widest access starting there
+    static constexpr unsigned long GUARD_SIZE = ADDRESS_SPACE + PAGE_SIZE;
+
+    // leaves the innermost run_guarded() with address as its fault, like an access of the guard region
+    [[noreturn]] static void fault(long address);
+
+    // the offset of a guest address, the engines and generated code all check it this way
+    [[gnu::always_inline]] static long offset(long address) {
+        if ((unsigned long) address >> 32 != 0) [[unlikely]] {
+            fault(address);
+        }
+        return address;
+    }
+
+    // size is at most ADDRESS_SPACE
+    explicit Memory(unsigned long size);
+    ~Memory();
+
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
+    // guest address 0, generated code indexes it with wrapped addresses
+    std::byte* data() { return base; }
+
+    template <typename T>
+    [[gnu::always_inline]] T load(long address) {
+        return ::load<T>(base, offset(address));
+    }
+
+    template <typename T>
+    [[gnu::always_inline]] void store(long address, T value) {
+        ::store<T>(base, offset(address), value);
+    }
+
+    // widened to a register value, sign-extending for a signed T and zero-extending for an unsigned T
+    template <typename T>
+    [[gnu::always_inline]] long load_extended(long address) {
+        return (long) load<T>(address);
+    }
+
+    // for callers outside of run_guarded(), like the debugger
+    bool contains(long address, unsigned long size) const {
+        return address >= 0 && (unsigned long) address <= size_ && size <= size_ - (unsigned long) address;
+    }
+
+    /*  Runs body; returns false with the guest address in fault if it accessed
+        the guard region or an address offset() rejects. The frames of body are
+        then left with siglongjmp, without unwinding, so no frame that is live
+        during a guest load or store may own an object with a non-trivial
+        destructor: the engines keep such state in members of the Interpreter.
+        A fault anywhere else is left to the previous SIGSEGV handler. */
+    template <typename Body>
+    bool run_guarded(Body&& body, long& fault) {
+        sigjmp_buf recovery;
+        Guard guard(*this, recovery);
+        if (sigsetjmp(recovery, 1) != 0) {
+            fault = fault_address;
+            return false;
+        }
+        body();
+        return true;
+    }
+
+    unsigned long size() const { return size_; }
+    // pages the host has mapped in, stores and loads alike
+    unsigned long resident_pages() const;
+
+   private:
+    std::byte* base;
+    unsigned long size_;
+    long fault_address = 0;
+
+    // makes this memory and recovery the target of the SIGSEGV handler while alive
+    class Guard {
+        Memory* previous_memory;
+        sigjmp_buf* previous_recovery;
+
+       public:
+        Guard(Memory& memory, sigjmp_buf& recovery);
+        ~Guard();
+    };
+
+    static void on_fault(int, siginfo_t* info, void*);
+};
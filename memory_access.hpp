@@ -0,0 +1,44 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*  Typed little-endian access to guest memory. Every width is a single memcpy,
+    which compiles to one host move, the byte order is only fixed up on a
+    big-endian host. */
+
+constexpr bool BIG_ENDIAN_HOST = std::endian::native == std::endian::big;
+
+template <typename T>
+inline T byte_swapped(T value) {
+  using Unsigned = std::make_unsigned_t<T>;
+  Unsigned bits = (Unsigned) value, swapped = 0;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    swapped = (Unsigned) ((swapped << 8) | (bits & 0xFF));
+    bits = (Unsigned) (bits >> 8);
+  }
+  return (T) swapped;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline T load(const std::byte* memory, long address) {
+  static_assert(std::is_integral_v<T>, "guest memory holds integers");
+  T value;
+  std::memcpy(&value, memory + address, sizeof(T));
+  if constexpr (BIG_ENDIAN_HOST) {
+    value = byte_swapped(value);
+  }
+  return value;
+}
+
+template <typename T>
+[[gnu::always_inline]] inline void store(std::byte* memory, long address, T value) {
+  static_assert(std::is_integral_v<T>, "guest memory holds integers");
+  if constexpr (BIG_ENDIAN_HOST) {
+    value = byte_swapped(value);
+  }
+  std::memcpy(memory + address, &value, sizeof(T));
+}
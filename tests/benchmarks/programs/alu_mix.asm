@@ -0,0 +1,25 @@
+# straight-line ALU work, every instruction writes a register: ten per iteration,
+# two of them discard their result into zero
+.section .text
+main:
+  li t0, 0
+  li t1, 5000000
+  li a0, 1
+  li a1, 7
+loop:
+  xor a2, a0, a1
+  slli a3, a2, 3
+  add a0, a0, a3
+  srli a4, a0, 5
+  or a1, a1, a4
+  and a5, a1, a0
+  sub a0, a0, a5
+  addi zero, a0, 1
+  add zero, a1, a2
+  addi t0, t0, 1
+  blt t0, t1, loop
+
+  li a7, 1
+  ecall
+  li a7, 10
+  ecall
@@ -0,0 +1,30 @@
+# fills a 100-word array on the stack and sums it, many times over
+.section .text
+main:
+  li s0, 100000
+  li a0, 0
+outer:
+  mv t0, sp
+  li t1, 100
+fill:
+  sw t1, 0(t0)
+  addi t0, t0, 8
+  addi t1, t1, -1
+  bne t1, zero, fill
+
+  mv t0, sp
+  li t1, 100
+sum:
+  lw t2, 0(t0)
+  add a0, a0, t2
+  addi t0, t0, 8
+  addi t1, t1, -1
+  bne t1, zero, sum
+
+  addi s0, s0, -1
+  bne s0, zero, outer
+
+  li a7, 1
+  ecall
+  li a7, 10
+  ecall
@@ -0,0 +1,22 @@
+# calls a small leaf function in a loop
+.section .text
+main:
+  li s0, 5000000
+  li a0, 0
+loop:
+  mv a1, s0
+  call add_one
+  addi s0, s0, -1
+  bne s0, zero, loop
+  j end
+
+add_one:
+  add a0, a0, a1
+  addi a0, a0, 1
+  ret
+
+end:
+  li a7, 1
+  ecall
+  li a7, 10
+  ecall
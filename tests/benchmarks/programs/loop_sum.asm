@@ -0,0 +1,15 @@
+# sum of 0..N-1 in a tight loop: three instructions per iteration
+.section .text
+main:
+  li t0, 0
+  li t1, 20000000
+  li a0, 0
+loop:
+  add a0, a0, t0
+  addi t0, t0, 1
+  blt t0, t1, loop
+
+  li a7, 1
+  ecall
+  li a7, 10
+  ecall
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+
+import os
+import sys
+import statistics
+import subprocess as sp
+from colorama import init, Fore
+
+init(autoreset=True)
+
+
+# Runs every program with --stats and reports the median instructions per second
+# with the range of the runs. Extra arguments are passed to the emulator, e.g. to
+# select an engine.
+# --baseline PATH runs another build of the emulator in alternation with this one
+# and also reports the median time ratio of the pairs and how many pairs this
+# build won: the machine drifts less within a pair than across a whole series.
+
+executable_file = "./../../main"
+runs = 11
+baseline_file = None
+extra_args = sys.argv[1:]
+if "--baseline" in extra_args:
+    at = extra_args.index("--baseline")
+    baseline_file = extra_args[at + 1]
+    del extra_args[at:at + 2]
+
+
+def run_once(executable, path):
+    res = sp.run([executable, path, "--stats"] + extra_args, capture_output=True, text=True)
+    if res.returncode != 0:
+        return None
+    stats = {}
+    for line in res.stderr.strip().splitlines():
+        name, _, value = line.partition(":")
+        stats[name.strip()] = value.strip()
+    # a build that exits without printing stats
+    return stats if "time" in stats else None
+
+
+def seconds(stats):
+    return float(stats["time"].split()[0])
+
+
+return_code = 0
+for file in sorted(os.listdir("./programs")):
+    if not file.endswith(".asm"):
+        continue
+    path = os.path.join("./programs", file)
+    series, ratios = [], []
+    for i in range(runs):
+        # the order within a pair alternates, the second run of a pair finds warmer caches
+        base = run_once(baseline_file, path) if baseline_file is not None and i % 2 == 1 else None
+        stats = run_once(executable_file, path)
+        if baseline_file is not None and i % 2 == 0:
+            base = run_once(baseline_file, path)
+        if stats is None or (baseline_file is not None and base is None):
+            series = []
+            break
+        series.append(stats)
+        if base is not None:
+            ratios.append(seconds(stats) / seconds(base))
+    if not series:
+        print(f"[{file}]: {Fore.RED}FAILED")
+        return_code = 1
+        continue
+    ips = sorted(float(stats["instructions per second"]) for stats in series)
+    line = (f"[{file}]: {series[0]['retired instructions']} instructions, {Fore.GREEN}{statistics.median(ips) / 1e6:.1f} M instr/s"
+            f"{Fore.RESET} (range {ips[0] / 1e6:.1f}-{ips[-1] / 1e6:.1f} over {runs} runs)")
+    if ratios:
+        won = sum(ratio < 1 for ratio in ratios)
+        line += f", time vs baseline {statistics.median(ratios):.3f}, faster in {won}/{runs}"
+    print(line)
+
+exit(return_code)
@@ -12,13 +12,40 @@ def find_test_folders():
     return sorted(test_folders)
 
 
-def run_executable(executable_path, input_file, output_file):
+def run_executable(executable_path, input_file, output_file, options=()):
+    command = [executable_path, input_file]
     with open(output_file, 'w') as f:
         try:
-            subprocess.run([executable_path, input_file],
+            subprocess.run(command + list(options),
                            stdout=f, text=True, check=True)
         except subprocess.CalledProcessError as e:
-            f.write(str(e))
+            # the expected output names the command without options
+            f.write(str(subprocess.CalledProcessError(e.returncode, command)))
+
+
+def run_aot(executable_path, input_file, output_file, library):
+    """Runs the program ahead of time compiled twice: the first run builds the
+    library, the second one has to load it as it is. Returns False when a run
+    went on without the library or the second one rebuilt it. A program that
+    is refused before it runs builds nothing."""
+    built = None
+    for _ in range(2):
+        command = [executable_path, input_file]
+        with open(output_file, 'w') as f:
+            result = subprocess.run(command + ["--aot", library],
+                                    stdout=f, stderr=subprocess.PIPE, text=True)
+            if result.returncode != 0:
+                f.write(str(subprocess.CalledProcessError(result.returncode, command)))
+        if "without " + library in result.stderr:
+            return False
+        if not os.path.exists(library):
+            # refused before it ran, there is nothing to build
+            return True
+        modified = os.path.getmtime(library)
+        if built is not None and modified != built:
+            return False
+        built = modified
+    return True
 
 
 def compare_output(output_file, expected_output_file):
@@ -26,6 +53,18 @@ def compare_output(output_file, expected_output_file):
         return f1.read().strip() == f2.read().strip()
 
 
+OPTIONS = [
+    [],
+    ["--lazy"],
+    ["--engine", "threaded"],
+    # blocks are translated on their first entry
+    ["--engine", "blocks", "--block-threshold", "0"],
+    ["--engine", "jit", "--jit-threshold", "0"],
+    # loops move through all three tiers within their first iterations
+    ["--engine", "tiered", "--block-threshold", "1", "--jit-threshold", "1"],
+]
+
+
 if __name__ == "__main__":
     executable_path = "../../../main"
     return_code = 0
@@ -37,15 +76,31 @@ if __name__ == "__main__":
         temp_output_file = os.path.join(folder, 'temp_output.txt')
 
         if os.path.exists(in_file) and os.path.exists(out_file):
-            run_executable(executable_path, in_file, temp_output_file)
+            # every program also runs with lines parsed on their first use and on every engine
+            for options in OPTIONS:
+                name = " ".join([folder] + options)
+                run_executable(executable_path, in_file, temp_output_file, options)
 
-            if compare_output(temp_output_file, out_file):
-                print(f"[{folder}]: {Fore.GREEN}PASSED")
-                os.remove(temp_output_file)
+                if compare_output(temp_output_file, out_file):
+                    print(f"[{name}]: {Fore.GREEN}PASSED")
+                    os.remove(temp_output_file)
+
+                else:
+                    print(f"[{name}]: {Fore.RED}FAILED")
+                    return_code = 1
+                    break
 
+            library = os.path.join(folder, 'aot.so')
+            name = f"{folder} --aot"
+            loaded = run_aot(executable_path, in_file, temp_output_file, library)
+            if loaded and compare_output(temp_output_file, out_file):
+                print(f"[{name}]: {Fore.GREEN}PASSED")
+                os.remove(temp_output_file)
             else:
-                print(f"[{folder}]: {Fore.RED}FAILED")
+                print(f"[{name}]: {Fore.RED}FAILED")
                 return_code = 1
+            if os.path.exists(library):
+                os.remove(library)
 
         else:
             print(
@@ -0,0 +1,29 @@
+.eqv N 2
+.eqv CH 'A'
+.macro print_char %src
+  mv a0, %src
+  li a7, 11
+  ecall
+.end_macro
+.macro print_n %ch, %n
+  li t0, %n
+  li t1, 0
+loop:
+  print_char %ch
+  addi t0, t0, -1
+  bne t0, t1, loop
+.end_macro
+.macro print_swapped %a, %b
+  print_n %b, %a
+.end_macro
+
+main:
+  li s1, CH
+  addi s2, s1, 1
+  print_swapped N, s1
+  print_swapped 3, s2
+  j NEXT
+  print_char s1
+NEXT:
+  li a7, 10
+  ecall
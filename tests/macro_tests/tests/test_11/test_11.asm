@@ -0,0 +1,15 @@
+.include "print.inc"
+
+main:
+  li a0, 'X'
+  li a1, 3
+  jal ra, repeat
+  li s1, NEWLINE
+  print_char s1
+  li a0, 'Y'
+  li a1, 2
+  jal ra, repeat
+  li a7, 10
+  ecall
+
+.include "repeat.inc"
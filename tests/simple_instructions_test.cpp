@@ -1,13 +1,21 @@
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <stdio.h>
 #include <iostream>
+#include <iterator>
 #include <vector>
 #include "../frontend/Parser.hpp"
+#include "../frontend/ElfLoader.hpp"
+#include "../frontend/ElfWriter.hpp"
+#include "../frontend/ProgramCache.hpp"
 #include "../exceptions/ParserException.hpp"
 #include "../exceptions/EmulatorException.hpp"
 #include "../State.hpp"
 #include "../instructions/instructions.hpp"
+#include "../instructions/encoding.hpp"
 
 
 void test_li_1() {
@@ -377,7 +385,7 @@ void test_sb_1() {
 
   Sb f = Sb({"a1", "4(a2)"});
   f.exec(state);
-  assert(state.memory[2 + 4] == (std::byte) 10);
+  assert(state.memory.load<uint8_t>(2 + 4) == (uint8_t) 10);
   printf("Test sb_1 passed!\n");
 }
 
@@ -391,8 +399,8 @@ void test_sh_1() {
 
   Sh f = Sh({"a1", "4(a2)"});
   f.exec(state);
-  assert(state.memory[2 + 4] == (std::byte) (1024 & 0xFF));
-  assert(state.memory[2 + 5] == (std::byte) ((1024 >> 8) & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 4) == (uint8_t) (1024 & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 5) == (uint8_t) ((1024 >> 8) & 0xFF));
   printf("Test sh_1 passed!\n");
 }
 
@@ -406,10 +414,10 @@ void test_sw_1() {
 
   Sw f = Sw({"a1", "4(a2)"});
   f.exec(state);
-  assert(state.memory[2 + 4 + 0] == (std::byte) (33554432 & 0xFF));
-  assert(state.memory[2 + 4 + 1] == (std::byte) ((33554432 >> 8) & 0xFF));
-  assert(state.memory[2 + 4 + 2] == (std::byte) ((33554432 >> 16) & 0xFF));
-  assert(state.memory[2 + 4 + 3] == (std::byte) ((33554432 >> 24) & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 4 + 0) == (uint8_t) (33554432 & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 4 + 1) == (uint8_t) ((33554432 >> 8) & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 4 + 2) == (uint8_t) ((33554432 >> 16) & 0xFF));
+  assert(state.memory.load<uint8_t>(2 + 4 + 3) == (uint8_t) ((33554432 >> 24) & 0xFF));
   printf("Test sw_1 passed!\n");
 }
 
@@ -421,7 +429,7 @@ void test_lb_1() {
   f1.exec(state);
   f2.exec(state);
 
-  state.memory[2 + 4] = (std::byte) 13;
+  state.memory.store<uint8_t>(2 + 4, (uint8_t) 13);
   Lb f = Lb({"a3", "4(a2)"});
   f.exec(state);
   assert(state.registers[a3] == 13);
@@ -437,10 +445,10 @@ void test_lh_1() {
   f1.exec(state);
   f2.exec(state);
 
-  state.memory[2 + 4] = (std::byte) (1024 & 0xFF);
-  state.memory[2 + 4 + 1] = (std::byte) ((1024 >> 8) & 0xFF);
-  state.memory[2 + 4 + 2] = (std::byte) 0;
-  state.memory[2 + 4 + 3] = (std::byte) 0;
+  state.memory.store<uint8_t>(2 + 4, (uint8_t) (1024 & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 1, (uint8_t) ((1024 >> 8) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 2, (uint8_t) 0);
+  state.memory.store<uint8_t>(2 + 4 + 3, (uint8_t) 0);
   Lh f = Lh({"a3", "4(a2)"});
   f.exec(state);
   assert(state.registers[a3] == 1024);
@@ -456,14 +464,14 @@ void test_lw_1() {
 
   long num = LONG_MAX;
 
-  state.memory[2 + 4] = (std::byte) (num & 0xFF);
-  state.memory[2 + 4 + 1] = (std::byte) ((num >> 8) & 0xFF);
-  state.memory[2 + 4 + 2] = (std::byte) ((num >> 16) & 0xFF);
-  state.memory[2 + 4 + 3] = (std::byte) ((num >> 24) & 0xFF);
-  state.memory[2 + 4 + 4] = (std::byte) ((num >> 32) & 0xFF);
-  state.memory[2 + 4 + 5] = (std::byte) ((num >> 40) & 0xFF);
-  state.memory[2 + 4 + 6] = (std::byte) ((num >> 48) & 0xFF);
-  state.memory[2 + 4 + 7] = (std::byte) ((num >> 56) & 0xFF);
+  state.memory.store<uint8_t>(2 + 4, (uint8_t) (num & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 1, (uint8_t) ((num >> 8) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 2, (uint8_t) ((num >> 16) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 3, (uint8_t) ((num >> 24) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 4, (uint8_t) ((num >> 32) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 5, (uint8_t) ((num >> 40) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 6, (uint8_t) ((num >> 48) & 0xFF));
+  state.memory.store<uint8_t>(2 + 4 + 7, (uint8_t) ((num >> 56) & 0xFF));
 
   Lw f = Lw({"a3", "4(a2)"});
   f.exec(state);
@@ -471,6 +479,147 @@ void test_lw_1() {
   printf("Test lw_1 passed!\n");
 }
 
+void test_memory_pages() {
+  State state(1 << 20);
+  Li f1 = Li({"a1", "-2"});
+  Li f2 = Li({"a2", "4094"});
+
+  f1.exec(state);
+  f2.exec(state);
+
+  // straddles the first two pages
+  Sw f = Sw({"a1", "0(a2)"});
+  f.exec(state);
+  assert(state.memory.resident_pages() == 2);
+  assert(state.memory.load<long>(4094) == -2);
+  assert(state.memory.load<long>(1 << 19) == 0);
+  printf("Test memory_pages passed!\n");
+}
+
+void test_memory_out_of_range() {
+  State state(1 << 20);
+  Li f1 = Li({"a2", "1048572"});
+
+  f1.exec(state);
+
+  // the last word straddles the end of memory into the guard region
+  Lw f = Lw({"a3", "0(a2)"});
+  long fault = 0;
+  assert(!state.memory.run_guarded([&] { f.exec(state); }, fault));
+  assert(fault == 1048576);
+  printf("Test memory_out_of_range passed!\n");
+}
+
+void test_memory_far_address() {
+  State state(1 << 20);
+  Li f1 = Li({"a1", "42"});
+  Li f2 = Li({"a2", "17592186044416"});
+  Li f3 = Li({"a4", "-8"});
+
+  f1.exec(state);
+  f2.exec(state);
+  f3.exec(state);
+
+  // 2^44 + 16 has bits above the lower 32 set: a fault, not an alias of address 16
+  Sw f4 = Sw({"a1", "16(a2)"});
+  long fault = 0;
+  assert(!state.memory.run_guarded([&] { f4.exec(state); }, fault));
+  assert(fault == 17592186044432);
+  assert(state.memory.load<long>(16) == 0);
+
+  // so is a negative address
+  Lw f = Lw({"a3", "0(a4)"});
+  assert(!state.memory.run_guarded([&] { f.exec(state); }, fault));
+  assert(fault == -8);
+  printf("Test memory_far_address passed!\n");
+}
+
+void test_encoding_roundtrip() {
+  // a 12-bit immediate, a 32-bit one split into lui + addiw, and one with no encoding
+  Li small = Li({"a1", "-2048"});
+  Li wide = Li({"a1", "305419896"});
+  Li huge = Li({"a1", "81985529216486895"});
+  Sw store = Sw({"a1", "16(sp)"});
+
+  for (const Instruction* instruction : std::vector<const Instruction*>{&small, &wide, &store}) {
+    DecodedInstruction decoded = instruction->decode();
+    DecodedInstruction again = decode_slot(encode_slot(decoded, 3), 3);
+    assert(again.opcode == decoded.opcode);
+    assert(again.rd == decoded.rd && again.rs1 == decoded.rs1 && again.rs2 == decoded.rs2);
+    assert(again.immediate == decoded.immediate);
+  }
+  assert(encode_slot(huge.decode(), 3) == NO_ENCODING);
+  printf("Test encoding_roundtrip passed!\n");
+}
+
+void test_program_cache() {
+  std::vector<std::string> lines = {".section .text", "main:", "  li a1, 305419896", "  sw a1, 16(sp)"};
+  Program program;
+  program.instructions = {Li({"a1", "305419896"}).decode(), Sw({"a1", "16(sp)"}).decode()};
+  program.labels = {{"main", 0}};
+  program.from_in_to_inparse = {-1, -1, 0, 1};
+  program.from_inparse_to_in = {2, 3};
+
+  const std::string dir = "/tmp/riscv_program_cache_test";
+  assert(store_cached_program(dir, lines, program));
+  Program loaded;
+  assert(load_cached_program(dir, lines, loaded));
+  assert(loaded.instructions.size() == 2 && loaded.instructions[1].immediate == 16);
+  assert(loaded.labels == program.labels);
+  assert(loaded.from_in_to_inparse == program.from_in_to_inparse && loaded.from_inparse_to_in == program.from_inparse_to_in);
+  assert(loaded.image[0] == encode_slot(program.instructions[0], 0));
+
+  // another source is a miss
+  lines[2] = "  li a1, 1";
+  assert(!load_cached_program(dir, lines, loaded));
+  printf("Test program_cache passed!\n");
+}
+
+void test_emit_elf() {
+  Program program;
+  program.instructions = {Data({"7"}).decode(), Li({"a1", "305419896"}).decode(), Lw({"a2", "-8(a1)"}).decode()};
+  program.labels = {{"value", 0}, {"main", 1}};
+
+  const std::string path = "/tmp/riscv_emit_test.elf";
+  write_elf(path, program);
+  assert(is_elf_file(path));
+  std::vector<std::string> listing;
+  long entry = -1;
+  Program loaded = load_elf(path, 1 << 20, listing, entry);
+  assert(entry == 8);
+  assert(loaded.labels == program.labels);
+  assert(loaded.instructions.size() == 3 && loaded.instructions[0].opcode == Opcode::Data && loaded.instructions[0].immediate == 7);
+  for (size_t i = 1; i < 3; i++) {
+    assert(loaded.instructions[i].opcode == program.instructions[i].opcode);
+    assert(loaded.instructions[i].immediate == program.instructions[i].immediate);
+  }
+
+  // a 64-bit constant is loaded from the pool after the program
+  program.instructions.push_back(Li({"a3", "81985529216486895"}).decode());
+  write_elf(path, program);
+  loaded = load_elf(path, 1 << 20, listing, entry);
+  assert(loaded.instructions.size() == 5 && loaded.instructions[4].opcode == Opcode::Data);
+  assert(loaded.instructions[3].opcode == Opcode::Li && loaded.instructions[3].rd == a3);
+  assert(loaded.instructions[3].immediate == 81985529216486895);
+
+  // a slot of code outside the decoded subset, here mul, is refused with its address
+  std::ifstream in(path, std::ios::binary);
+  std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  const uint64_t li = loaded.image[1], mul = 0x0000001302b50533;
+  const size_t at = bytes.find(std::string(reinterpret_cast<const char*>(&li), sizeof(li)));
+  assert(at != std::string::npos);
+  std::memcpy(bytes.data() + at, &mul, sizeof(mul));
+  std::ofstream(path, std::ios::binary) << bytes;
+  try {
+    load_elf(path, 1 << 20, listing, entry);
+    assert(false);
+  } catch (const LoaderException& e) {
+    assert(e.get_message() == "Unsupported instruction 0x1302b50533 at 0x8 of " + path);
+  }
+  printf("Test emit_elf passed!\n");
+}
+
 /* 
 void test_ecall_print_int() {
   State state;
@@ -581,11 +730,18 @@ void test_all() {
     test_lh_1();
     test_lw_1();
 
+    test_memory_pages();
+    test_memory_out_of_range();
+    test_memory_far_address();
+    test_encoding_roundtrip();
+    test_program_cache();
+    test_emit_elf();
     
   }
   catch (const EmulatorException& e)
   {
     std::cerr << e.get_message() << '\n';
+    std::exit(1);
   }
   
 
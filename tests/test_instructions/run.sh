@@ -0,0 +1,5 @@
+clang++ test_instructions.cpp ../simple_instructions_test.cpp ../../frontend/Lexer.cpp ../../frontend/Parser.cpp ../../frontend/Preprocessor.cpp ../../frontend/SourceFile.cpp ../../frontend/Reassembler.cpp ../../frontend/ModuleCache.cpp ../../frontend/ProgramCache.cpp ../../frontend/ElfLoader.cpp ../../frontend/ElfWriter.cpp ../../instructions/instructions_impl.cpp ../../instructions/fusion.cpp ../../instructions/encoding.cpp ../../memory/Memory.cpp -std=c++20 -pthread -w
+if [ $? -eq 0 ]
+then
+  ./a.out
+fi
@@ -0,0 +1,5 @@
+#include "../simple_instructions_test.hpp"
+
+int main() {
+  test_all();
+}
@@ -1,4 +1,4 @@
-clang++ test_check_syntax.cpp test_labels.cpp test_get_offset.cpp test_parser.cpp test_is_number.cpp ../../frontend/Lexer.cpp ../../frontend/Parser.cpp ../../frontend/Preprocessor.cpp test_get_immediate.cpp ../../instructions/instructions_impl.cpp ../../instructions/instructions.hpp -std=c++17 -w
+clang++ test_check_syntax.cpp test_labels.cpp test_parallel.cpp test_lazy.cpp test_reassembler.cpp test_get_offset.cpp test_parser.cpp test_is_number.cpp ../../frontend/Lexer.cpp ../../frontend/Parser.cpp ../../frontend/Preprocessor.cpp ../../frontend/SourceFile.cpp ../../frontend/Reassembler.cpp ../../frontend/ModuleCache.cpp test_get_immediate.cpp test_get_register.cpp ../../instructions/instructions_impl.cpp ../../memory/Memory.cpp ../../instructions/instructions.hpp -std=c++20 -pthread -w
 if [ $? -eq 0 ]
 then
   ./a.out
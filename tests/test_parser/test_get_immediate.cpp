@@ -1,6 +1,7 @@
 #include "../../frontend/Parser.hpp"
 #include <assert.h>
 #include <cassert>
+#include <climits>
 
 void Itest_1() { assert(Parser::get_immediate("12") == 12); }
 
@@ -28,6 +29,16 @@ void Itest_12() { assert(Parser::get_immediate("'\n'") == '\n'); }
 
 void Itest_13() { assert(Parser::get_immediate("0xa0000000") == 2684354560); }
 
+void Itest_14() { assert(Parser::get_immediate("-9223372036854775808") == LONG_MIN); }
+
+void Itest_15() {
+    try {
+        Parser::get_immediate("9223372036854775808");
+        assert(false);
+    } catch (const ParserException& e) {
+    }
+}
+
 void test_get_immediate() {
   Itest_1();
   Itest_2();
@@ -42,6 +53,8 @@ void test_get_immediate() {
   Itest_11();
   Itest_12();
   Itest_13();
+  Itest_14();
+  Itest_15();
 
   std::cout << "Get immediate tests passed" << std::endl;
 }
@@ -0,0 +1,34 @@
+#include "../../frontend/Parser.hpp"
+#include "../../exceptions/ParserException.hpp"
+#include <assert.h>
+
+void Rtest_1() { assert(Parser::get_register("a0") == a0); }
+
+void Rtest_2() { assert(Parser::get_register("x0") == zero); }
+
+void Rtest_3() { assert(Parser::get_register("x10") == a0); }
+
+void Rtest_4() { assert(Parser::get_register("fp") == s0 && Parser::get_register("x8") == s0); }
+
+void Rtest_5() { assert(Parser::get_register("x31") == t6); }
+
+void Rtest_6() {
+    try {
+        Parser::get_register("x32");
+        assert(false);
+    } catch (const ParserException& e) {
+    }
+}
+
+void Rtest_7() { assert(Parser::get_register_names().size() == 33); }
+
+void test_get_register() {
+    Rtest_1();
+    Rtest_2();
+    Rtest_3();
+    Rtest_4();
+    Rtest_5();
+    Rtest_6();
+    Rtest_7();
+    std::cout << "Get register tests passed" << std::endl;
+}
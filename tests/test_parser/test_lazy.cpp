@@ -0,0 +1,64 @@
+#include "../../frontend/Parser.hpp"
+#include "../../frontend/Preprocessor.hpp"
+#include "../../frontend/Lexer.hpp"
+#include "assert.h"
+
+// the .word is parsed up front, the wrong register in line 8 only by parse_line()
+void Lztest_1() {
+    Preprocessor preprocessor = Preprocessor("labels_input/lazy-in.txt");
+    preprocessor.preprocess();
+    Lexer lexer(preprocessor.get_inparse());
+    Parser parser(lexer, preprocessor.get_labels(), preprocessor.get_from_inparse_to_in());
+    vector<DecodedInstruction> program = parser.get_lazy_program();
+    assert(program.size() == 5);
+    assert(program[0].opcode == Opcode::Data && program[0].immediate == 7);
+    for (int i = 1; i < 5; i++) {
+        assert(program[i].opcode == Opcode::Unparsed);
+    }
+
+    DecodedInstruction li = parser.parse_line(2, program[2].immediate);
+    assert(li.opcode == Opcode::Li && li.immediate == 3);
+    DecodedInstruction jump = parser.parse_line(4, program[4].immediate);
+    assert(jump.opcode == Opcode::Jump && jump.target == 1);
+    try {
+        parser.parse_line(3, program[3].immediate);
+        assert(false);
+    } catch (const ParserException& e) {
+        assert(e.get_message() == "In line 8 invalid register: t9");
+    }
+    cout << "lazy test 1 passed!" << endl;
+}
+
+// plain lines before the .eqv are only preprocessed by parse_line(), from their source line
+void Lztest_2() {
+    Preprocessor preprocessor = Preprocessor("labels_input/lazy-eqv-in.txt");
+    vector<string> lines = preprocessor.all_lines_in();
+    preprocessor.defer_plain_lines();
+    preprocessor.preprocess();
+    assert(preprocessor.get_inparse() == "\n\nli t0, 3\nj main\n");
+    Lexer lexer(preprocessor.get_inparse());
+    Parser parser(lexer, preprocessor.get_labels(), preprocessor.get_from_inparse_to_in());
+    parser.set_source_lines(lines);
+    vector<DecodedInstruction> program = parser.get_lazy_program();
+    assert(program.size() == 4);
+
+    DecodedInstruction first = parser.parse_line(0, program[0].immediate);
+    assert(first.opcode == Opcode::Li && first.rd == a0 && first.immediate == 1);
+    DecodedInstruction three = parser.parse_line(2, program[2].immediate);
+    assert(three.opcode == Opcode::Li && three.immediate == 3);
+    DecodedInstruction jump = parser.parse_line(3, program[3].immediate);
+    assert(jump.opcode == Opcode::Jump && jump.target == 0);
+    try {
+        parser.parse_line(1, program[1].immediate);
+        assert(false);
+    } catch (const ParserException& e) {
+        assert(e.get_message() == "In line 4 invalid register: t9");
+    }
+    cout << "lazy test 2 passed!" << endl;
+}
+
+void test_lazy() {
+    Lztest_1();
+    Lztest_2();
+    cout << "All lazy tests passed!" << endl;
+}
@@ -0,0 +1,79 @@
+#include "../../frontend/Parser.hpp"
+#include "../../frontend/Preprocessor.hpp"
+#include "../../frontend/Lexer.hpp"
+#include "assert.h"
+#include <cstdio>
+#include <fstream>
+
+// enough lines for every thread to get a chunk above Parser::MIN_BYTES_PER_THREAD
+static const int LINES = 40000;
+static const char* INPUT = "parallel_input.txt";
+
+// the lines in bad are replaced by an instruction with a wrong register
+static void write_program(const std::set<int>& bad) {
+    std::ofstream out(INPUT);
+    for (int i = 0; i < LINES; i++) {
+        if (i % 1000 == 0) {
+            out << "label_" << i / 1000 << ":\n";
+        }
+        if (bad.count(i)) {
+            out << "    add t0, t9, t1\n";
+        } else if (i % 3 == 0) {
+            out << "    addi t0, t0, " << i << "\n";
+        } else {
+            out << "    bne t0, t1, label_" << (LINES - 1 - i) / 1000 << "\n";
+        }
+    }
+}
+
+static vector<DecodedInstruction> parse(unsigned threads) {
+    Preprocessor preprocessor = Preprocessor(INPUT);
+    preprocessor.preprocess();
+    Lexer lexer(preprocessor.get_inparse());
+    Parser parser(lexer, preprocessor.get_labels(), preprocessor.get_from_inparse_to_in());
+    vector<Instruction*> instructions = parser.get_instructions(threads);
+    vector<DecodedInstruction> program;
+    for (Instruction* instruction : instructions) {
+        program.push_back(instruction->decode());
+        delete instruction;
+    }
+    return program;
+}
+
+static string parse_error(unsigned threads) {
+    try {
+        parse(threads);
+    } catch (const ParserException& e) {
+        return e.get_message();
+    }
+    return "";
+}
+
+void Ptest_1() {
+    write_program({});
+    vector<DecodedInstruction> serial = parse(1);
+    vector<DecodedInstruction> parallel = parse(4);
+    assert(serial.size() == LINES && parallel.size() == LINES);
+    for (int i = 0; i < LINES; i++) {
+        assert(serial[i].opcode == parallel[i].opcode);
+        assert(serial[i].rd == parallel[i].rd && serial[i].rs1 == parallel[i].rs1 && serial[i].rs2 == parallel[i].rs2);
+        assert(serial[i].immediate == parallel[i].immediate && serial[i].target == parallel[i].target);
+    }
+    cout << "parallel test 1 passed!" << endl;
+}
+
+void Ptest_2() {
+    // the errors are in different chunks, the earlier one is reported
+    write_program({25000, 38000});
+    string error = parse_error(1);
+    assert(error == "In line 25027 invalid register: t9");
+    assert(parse_error(4) == error);
+    cout << "parallel test 2 passed!" << endl;
+}
+
+void test_parallel() {
+    Ptest_1();
+    Ptest_2();
+    std::remove(INPUT);
+    cout << "All parallel tests passed!" << endl;
+}
@@ -3,7 +3,11 @@
 int main() {
   test_is_number();
   test_get_immediate();
+  test_get_register();
   test_get_offset();
   test_check_sytax();
   test_labels();
+  test_parallel();
+  test_lazy();
+  test_reassembler();
 }
@@ -2,4 +2,8 @@ void test_is_number();
 void test_get_immediate();
 void test_get_offset();
 void test_check_sytax();
-void test_labels();
\ No newline at end of file
+void test_labels();
+void test_get_register();
+void test_parallel();
+void test_lazy();
+void test_reassembler();
\ No newline at end of file
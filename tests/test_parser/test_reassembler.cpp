@@ -0,0 +1,116 @@
+#include "../../frontend/Parser.hpp"
+#include "../../frontend/Preprocessor.hpp"
+#include "../../frontend/Reassembler.hpp"
+#include "assert.h"
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+static const char* SOURCE = "reassembler_input.txt";
+
+static void write_source(const std::string& text) {
+    std::ofstream out(SOURCE);
+    out << text;
+}
+
+static const std::string PROGRAM = ".eqv STEP 2\nmain:\n  li t0, 1\n  addi t0, t0, STEP\n  j main\n";
+
+// PROGRAM through the frontend into program and lines, and its reassembler, lazy as for --lazy
+static std::unique_ptr<Reassembler> assemble(Program& program, std::vector<std::string>& lines, bool lazy = false) {
+    write_source(PROGRAM);
+    auto preprocessor = std::make_unique<Preprocessor>(SOURCE);
+    lines = preprocessor->all_lines_in();
+    preprocessor->preprocess();
+    program.labels = preprocessor->get_labels();
+    program.from_in_to_inparse = preprocessor->get_from_in_to_inparse();
+    program.from_inparse_to_in = preprocessor->get_from_inparse_to_in();
+    Parser parser(Lexer(preprocessor->get_inparse()), program.labels, program.from_inparse_to_in);
+    program.instructions = lazy ? parser.get_lazy_program() : parser.get_program();
+    return std::make_unique<Reassembler>(SOURCE, "", std::move(preprocessor), program, lines);
+}
+
+void RAtest_1() {
+    // one instruction line edited: only it is parsed again, with the .eqv of the first pass
+    Program program;
+    std::vector<std::string> lines;
+    std::unique_ptr<Reassembler> reassembler = assemble(program, lines);
+    Reassembler::Reassembly reassembly;
+    assert(!reassembler->reassemble(program.instructions, reassembly));
+
+    write_source(".eqv STEP 2\nmain:\n  li t0, STEP\n  addi t0, t0, STEP\n  j main\n");
+    assert(reassembler->reassemble(program.instructions, reassembly));
+    assert(!reassembly.full && reassembly.same_layout);
+    assert(reassembly.changed == std::vector<size_t>{0});
+    assert(reassembly.instructions[0].opcode == Opcode::Li && reassembly.instructions[0].immediate == 2);
+    assert(lines[2] == "  li t0, STEP");
+    cout << "reassembler test 1 passed!" << endl;
+}
+
+void RAtest_2() {
+    // a new .eqv value goes through the whole frontend, an added line moves everything after it
+    Program program;
+    std::vector<std::string> lines;
+    std::unique_ptr<Reassembler> reassembler = assemble(program, lines);
+    Reassembler::Reassembly reassembly;
+
+    write_source(".eqv STEP 3\nmain:\n  li t0, 1\n  addi t0, t0, STEP\n  j main\n");
+    assert(reassembler->reassemble(program.instructions, reassembly));
+    assert(reassembly.full && reassembly.same_layout);
+    assert(reassembly.changed == std::vector<size_t>{1});
+    program.instructions = reassembly.instructions;
+
+    write_source(".eqv STEP 3\nstart:\n  li t0, 1\nmain:\n  addi t0, t0, STEP\n  j main\n");
+    reassembly = {};
+    assert(reassembler->reassemble(program.instructions, reassembly));
+    assert(reassembly.full && !reassembly.same_layout);
+    assert(program.labels["main"] == 1 && program.from_inparse_to_in[1] == 4);
+    assert(reassembly.instructions[2].target == 1);
+    cout << "reassembler test 2 passed!" << endl;
+}
+
+void RAtest_3() {
+    // a program that does not assemble leaves the old one as it was
+    Program program;
+    std::vector<std::string> lines;
+    std::unique_ptr<Reassembler> reassembler = assemble(program, lines);
+    Reassembler::Reassembly reassembly;
+
+    write_source(".eqv STEP 2\nmain:\n  li t0, 1\n  addi t9, t0, STEP\n  j main\n");
+    try {
+        reassembler->reassemble(program.instructions, reassembly);
+        assert(false);
+    } catch (const ParserException& e) {
+        assert(e.get_message() == "In line 4 invalid register: t9");
+    }
+    assert(lines[3] == "  addi t0, t0, STEP");
+    cout << "reassembler test 3 passed!" << endl;
+}
+
+void RAtest_4() {
+    // a lazy program: a full pass leaves nothing unparsed, an edited line only itself parsed
+    Program program;
+    std::vector<std::string> lines;
+    std::unique_ptr<Reassembler> reassembler = assemble(program, lines, true);
+    assert(program.instructions[2].opcode == Opcode::Unparsed);
+    Reassembler::Reassembly reassembly;
+
+    write_source(".eqv STEP 2\nmain:\n  li t0, 5\n  addi t0, t0, STEP\n  j main\n");
+    assert(reassembler->reassemble(program.instructions, reassembly));
+    assert(!reassembly.full && reassembly.unparsed == 2);
+
+    write_source(".eqv STEP 3\nmain:\n  li t0, 5\n  addi t0, t0, STEP\n  j main\n");
+    reassembly = {};
+    assert(reassembler->reassemble(program.instructions, reassembly));
+    assert(reassembly.full && reassembly.same_layout && reassembly.unparsed == 0);
+    assert(reassembly.changed == (std::vector<size_t>{0, 1, 2}));
+    cout << "reassembler test 4 passed!" << endl;
+}
+
+void test_reassembler() {
+    RAtest_1();
+    RAtest_2();
+    RAtest_3();
+    RAtest_4();
+    std::remove(SOURCE);
+    cout << "All reassembler tests passed!" << endl;
+}